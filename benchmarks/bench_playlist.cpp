@@ -0,0 +1,326 @@
+// Microbenchmarks of the Playlist and Track hot paths over synthetic playlists.
+// One JSON object per line on the standard output:
+//   {"benchmark":"nextTrack","variant":"RepeatWholePlaylist","tracks":1000,"iterations":...,"ns_per_op":...}
+//
+// Usage: implayer_bench [--max-tracks N] [--max-import-tracks N] [--min-time-ms N] [--filter substring]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/logger.hpp"
+#include "core/playback_order.hpp"
+#include "core/playlist.hpp"
+#include "core/track.hpp"
+#include "core/track_cache.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+struct Settings
+{
+    int maxTracks{1000000};
+    int maxImportTracks{100000}; // importing writes one file per track
+    std::chrono::milliseconds minTime{200};
+    std::string filter;
+};
+
+Settings settings;
+
+// Every tenth track repeats the title and artist of the previous one, for removeDuplicate. Every title
+// has the word "song", for search.
+TrackList makeTracks(int count)
+{
+    static const auto content = std::make_shared<const std::string>(
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt");
+    TrackList tracks;
+    tracks.reserve(count);
+    for (int i = 0; i < count; ++i)
+    {
+        int id = i % 10 == 9 ? i - 1 : i;
+        auto track = std::make_shared<Track>();
+        track->initFromFields("track" + std::to_string(i) + ".txt", "song title" + std::to_string(id),
+                              "artist" + std::to_string(id % 1000), "mp3", 500, *content, content);
+        tracks.push_back(std::move(track));
+    }
+    return tracks;
+}
+
+std::unique_ptr<Playlist> makePlaylist(const TrackList& tracks)
+{
+    auto playlist = std::make_unique<Playlist>();
+    playlist->setName("bench");
+    playlist->setDescription("synthetic playlist");
+    for (const auto& track : tracks)
+    {
+        playlist->addTrack(track);
+    }
+    return playlist;
+}
+
+void setRepeatMode(Playlist& playlist, RepeatMode mode)
+{
+    while (playlist.getRepeatMode() != mode)
+    {
+        playlist.repeat();
+    }
+}
+
+const char* toString(RepeatMode mode)
+{
+    switch (mode)
+    {
+    case RepeatMode::NoRepeat: return "NoRepeat";
+    case RepeatMode::RepeatWholePlaylist: return "RepeatWholePlaylist";
+    default: return "RepeatCurrentSong";
+    }
+}
+
+void report(const std::string& name, const std::string& variant, int tracks, std::uint64_t iterations,
+            Clock::duration elapsed, std::uint64_t opsPerIteration)
+{
+    auto ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    std::cout << "{\"benchmark\":\"" << name << "\",\"variant\":\"" << variant << "\",\"tracks\":" << tracks
+              << ",\"iterations\":" << iterations << ",\"ops_per_iteration\":" << opsPerIteration
+              << ",\"ns_per_op\":" << ns / (iterations * opsPerIteration) << "}" << std::endl;
+}
+
+// Call setup (not timed) then body (timed) until minTime is spent, at least once.
+// body performs opsPerIteration operations.
+void run(const std::string& name, const std::string& variant, int tracks, std::uint64_t opsPerIteration,
+         const std::function<void()>& setup, const std::function<void()>& body)
+{
+    if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos)
+    {
+        return;
+    }
+    Clock::duration elapsed{0};
+    std::uint64_t iterations = 0;
+    do
+    {
+        setup();
+        auto start = Clock::now();
+        body();
+        elapsed += Clock::now() - start;
+        ++iterations;
+    } while (elapsed < settings.minTime);
+    report(name, variant, tracks, iterations, elapsed, opsPerIteration);
+}
+
+void benchEdits(int count, const TrackList& tracks)
+{
+    std::unique_ptr<Playlist> playlist;
+    run("addTrack", "", count, count, [&] { playlist = std::make_unique<Playlist>(); },
+        [&]
+        {
+            for (const auto& track : tracks)
+            {
+                playlist->addTrack(track);
+            }
+        });
+
+    // Random positions, the playlist is rebuilt between the iterations
+    const int removals = std::min(count, 100);
+    std::vector<int> indices;
+    std::mt19937 random(42);
+    for (int i = 0; i < removals; ++i)
+    {
+        indices.push_back(std::uniform_int_distribution<int>(0, count - 1 - i)(random));
+    }
+    run("removeTrack", "", count, removals, [&] { playlist = makePlaylist(tracks); },
+        [&]
+        {
+            for (int index : indices)
+            {
+                playlist->removeTrack(index);
+            }
+        });
+
+    run("removeDuplicate", "TitleArtist", count, 1, [&] { playlist = makePlaylist(tracks); },
+        [&] { playlist->removeDuplicate(DuplicateKey::TitleArtist); });
+    run("removeDuplicate", "Content", count, 1, [&] { playlist = makePlaylist(tracks); },
+        [&] { playlist->removeDuplicate(DuplicateKey::Content); });
+}
+
+void benchNavigation(int count, const TrackList& tracks)
+{
+    auto playlist = makePlaylist(tracks);
+    // At least a full pass, enough steps to be measurable on small playlists
+    const std::uint64_t steps = std::max(count, 100000);
+    for (auto mode : {RepeatMode::NoRepeat, RepeatMode::RepeatWholePlaylist, RepeatMode::RepeatCurrentSong})
+    {
+        setRepeatMode(*playlist, mode);
+        run("nextTrack", toString(mode), count, steps, [&] { playlist->resetToFirstTrack(); },
+            [&]
+            {
+                for (std::uint64_t i = 0; i < steps; ++i)
+                {
+                    if (!playlist->nextTrack(true))
+                    {
+                        playlist->resetToFirstTrack();
+                    }
+                }
+            });
+        run("previousTrack", toString(mode), count, steps, [&] { playlist->seek(count - 1); },
+            [&]
+            {
+                for (std::uint64_t i = 0; i < steps; ++i)
+                {
+                    if (!playlist->previousTrack())
+                    {
+                        playlist->seek(count - 1);
+                    }
+                }
+            });
+    }
+    setRepeatMode(*playlist, RepeatMode::NoRepeat);
+
+    // The first shuffle draws the permutation, the toggles after it reuse the drawn one
+    PlaybackOrder order;
+    run("shuffle", "first", count, 1,
+        [&]
+        {
+            order.unshuffle();
+            order.assign(count);
+            order.seed(42);
+        },
+        [&] { order.shuffle(); });
+    playlist->seed(42);
+    run("shuffle", "toggle", count, 1, [&] { playlist->unshuffle(); }, [&] { playlist->shuffle(); });
+    run("unshuffle", "", count, 1, [&] { playlist->shuffle(); }, [&] { playlist->unshuffle(); });
+    run("reshuffle", "", count, 1, [] {}, [&] { playlist->reshuffle(); });
+}
+
+void benchSearch(int count, const TrackList& tracks)
+{
+    auto playlist = makePlaylist(tracks);
+    auto title = "title" + std::to_string(count / 2);
+    run("search", "word", count, 1, [] {}, [&] { playlist->search(title); });
+    playlist->search("artist12*"); // sorts the words once
+    run("search", "prefix", count, 1, [] {}, [&] { playlist->search("artist12*"); });
+    // Every track matches, the first 10 are kept
+    run("search", "common-words", count, 1, [] {}, [&] { playlist->search("song", 10); });
+}
+
+// tracks/ holds one file per synthetic track, written once for the largest import
+void writeTrackFiles(const fs::path& folder, int count)
+{
+    fs::create_directories(folder / "tracks");
+    for (int i = 0; i < count; ++i)
+    {
+        std::ofstream out(folder / "tracks" / ("track" + std::to_string(i) + ".txt"));
+        out << "title song title" << i << "\nartist artist" << i % 1000 << "\ncodec mp3\nduration 500\n"
+            << "content Lorem ipsum dolor sit amet, consectetur adipiscing elit\n";
+    }
+}
+
+void benchFiles(int count, const fs::path& folder)
+{
+    auto playlistPath = folder / ("playlist" + std::to_string(count) + ".txt");
+    {
+        std::ofstream out(playlistPath);
+        out << "bench\nsynthetic playlist\n";
+        for (int i = 0; i < count; ++i)
+        {
+            out << "tracks/track" << i << ".txt\n";
+        }
+    }
+
+    std::unique_ptr<Playlist> playlist;
+    for (bool cached : {false, true})
+    {
+        ImportOptions options;
+        options.useCache = cached;
+        if (cached)
+        {
+            Playlist().importFromFile(playlistPath, options); // fill the TrackCache
+        }
+        run("importFromFile", cached ? "cached" : "parse", count, count,
+            [&]
+            {
+                playlist = std::make_unique<Playlist>();
+                if (!cached)
+                {
+                    TrackCache::instance().clear();
+                }
+            },
+            [&] { playlist->importFromFile(playlistPath, options); });
+    }
+
+    auto exportPath = folder / "export.txt";
+    run("exportToFile", "", count, count, [] {}, [&] { playlist->exportToFile(exportPath); });
+}
+
+bool parseArguments(int argc, char* argv[])
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--max-tracks")
+        {
+            settings.maxTracks = std::stoi(value);
+        }
+        else if (option == "--max-import-tracks")
+        {
+            settings.maxImportTracks = std::stoi(value);
+        }
+        else if (option == "--min-time-ms")
+        {
+            settings.minTime = std::chrono::milliseconds(std::stoi(value));
+        }
+        else if (option == "--filter")
+        {
+            settings.filter = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return argc % 2 == 1;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (!parseArguments(argc, argv))
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--max-tracks N] [--max-import-tracks N] [--min-time-ms N] [--filter substring]"
+                  << std::endl;
+        return 1;
+    }
+    // The playlist operations log on the standard output, which carries the results
+    Logger::instance().setLevel(LogLevel::Off);
+
+    auto folder = fs::temp_directory_path() / "implayer_bench";
+    fs::remove_all(folder);
+    int importTracks = std::min(settings.maxTracks, settings.maxImportTracks);
+    writeTrackFiles(folder, importTracks);
+
+    for (int count = 10; count <= settings.maxTracks; count *= 10)
+    {
+        auto tracks = makeTracks(count);
+        benchEdits(count, tracks);
+        benchNavigation(count, tracks);
+        benchSearch(count, tracks);
+        if (count <= importTracks)
+        {
+            benchFiles(count, folder);
+        }
+    }
+
+    fs::remove_all(folder);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#ifndef _WIN32
+#include <termios.h>
+#endif
+
+// Process-wide reader of the console input, shared by the key handler and the prompts so that keys and
+// lines typed ahead (or piped in) are consumed in order.
+//
+// On POSIX terminals the key handler runs in raw mode: every key is delivered at once, without echo.
+// Prompts switch back to the line mode while reading, for echo and line editing.
+class ConsoleInput
+{
+public:
+    static ConsoleInput& instance();
+    ~ConsoleInput();
+
+    ConsoleInput(const ConsoleInput&) = delete;
+    ConsoleInput& operator=(const ConsoleInput&) = delete;
+
+    // Read a whole line (without the end of line), blocking. Return false at the end of the input.
+    bool readLine(std::string& line);
+
+    // Scripted mode (command replay): readLine returns the scripted lines and never reads the console
+    void setScripted(bool scripted);
+    void pushScriptedLine(std::string line);
+
+#ifndef _WIN32
+    static constexpr int Fd = 0;
+
+    // No-op if the input is not a terminal. A terminating signal (e.g. Ctrl-C) restores the mode before
+    // the process dies.
+    void enableRawMode();
+    void restoreMode();
+
+    // Append what can be read without blocking to the pending input. Return false at the end of the input.
+    bool readAvailable();
+    // Pop the next pending key. Return false if there is none.
+    bool nextKey(char& key);
+
+private:
+    ConsoleInput() = default;
+    // Blocking read of at least one byte. Return false at the end of the input.
+    bool readMore();
+
+    std::string m_pending; // read but not consumed yet
+    bool m_isRaw{false};
+    termios m_savedMode{};
+#else
+private:
+    ConsoleInput() = default;
+#endif
+    bool readConsoleLine(std::string& line);
+
+    bool m_isScripted{false};
+    std::deque<std::string> m_scripted;
+};
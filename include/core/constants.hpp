@@ -1,8 +1,28 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 
 using namespace std::chrono_literals;
 
-const auto DelayBetweenContent = 700ms;
-const auto DelayBetweenTracks = 1000ms; // in milliseconds
\ No newline at end of file
+const auto DelayBetweenContent = 700ms; // used for tracks without duration
+const auto MinDelayBetweenContent = 1ms;
+// Pause between two tracks, counted from the end of the first one so that it includes the transition.
+// Short since the next track is prefetched: the transition does no I/O.
+const auto DelayBetweenTracks = 200ms;
+const std::size_t CommandQueueCapacity = 256;
+
+const unsigned DefaultImportThreads = 0; // one per hardware thread
+const std::size_t ImportBatchSize = 64; // number of track files a worker parses before grabbing new ones
+// TrackLoadMode::MemoryMapped reads smaller files: a mapping takes at least a page and one of the
+// process's limited mappings (vm.max_map_count), which only pays off for large contents
+const std::size_t MinMappedFileSize = 64 * 1024;
+const std::size_t DefaultTrackCacheBudget = 256 * 1024 * 1024; // bytes of tracks kept by the TrackCache
+const int DefaultContentWindow = 2; // lazy tracks keep their content this many tracks around the current one
+
+const std::size_t SearchResultsShown = 10; // matches listed by the player's search command
+
+const std::size_t RenderBatchSize = 512; // number of chunks gathered in a single vectored write
+
+const std::size_t OutputSinkCapacity = 1024; // number of messages queued for the output writer thread
+const std::size_t OutputSinkFlushBytes = 64 * 1024; // the writer thread writes at least this often
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+// Writes chunks of content straight to a file descriptor, one system call per chunk (more only if the
+// chunk is written partially), bypassing the formatting and locking of the iostreams.
+class ContentWriter
+{
+public:
+    static constexpr int StdoutFd = 1;
+
+    // Write to fd, which is not closed by the writer
+    explicit ContentWriter(int fd = StdoutFd);
+    ~ContentWriter();
+
+    ContentWriter(const ContentWriter&) = delete;
+    ContentWriter& operator=(const ContentWriter&) = delete;
+
+    // Create or truncate the file at path and write to it from now on. Return false on failure.
+    bool open(const std::filesystem::path& path);
+
+    // Return false if the chunk could not be written entirely
+    bool write(std::string_view chunk);
+    // Gather count chunks in as few system calls as possible (writev)
+    bool write(const std::string_view* chunks, std::size_t count);
+
+    std::uint64_t bytesWritten() const;
+
+private:
+    void close();
+
+    int m_fd;
+    bool m_ownsFd{false};
+    std::uint64_t m_bytesWritten{0};
+};
@@ -5,4 +5,43 @@ enum class RepeatMode
     NoRepeat,
     RepeatWholePlaylist,
     RepeatCurrentSong,
-};
\ No newline at end of file
+};
+
+enum class TrackLoadMode
+{
+    Copy,         // read the file into memory owned by the track
+    MemoryMapped, // map the file, fields are views into the mapping
+    Lazy,         // parse the metadata only, read the content from the file on first use
+};
+
+// What makes two tracks duplicates of each other
+enum class DuplicateKey
+{
+    TitleArtist, // same title and artist, ignoring case and extra whitespace
+    Content,     // same content
+    Path,        // same track file
+};
+
+// What a producer does when the output buffer is full
+enum class BackpressurePolicy
+{
+    Drop,      // discard the new message
+    Block,     // wait for room
+    Overwrite, // discard the oldest queued message
+};
+
+enum class LogLevel
+{
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+enum class LogFormat
+{
+    Console,   // human readable, with ANSI colors
+    JsonLines, // one JSON object per record on stderr, with a monotonic timestamp
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+// Single-threaded poll() loop: dispatches readable file descriptors, timers and callbacks posted from
+// other threads. The thread running it sleeps in poll() until one of them is due, nothing is polled
+// periodically.
+class EventLoop
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Loop thread only (or before run())
+    // Call onReadable each time fd has data to read (or is at its end, or closed). One callback per
+    // descriptor.
+    void watch(int fd, Callback onReadable);
+    void unwatch(int fd);
+    // Call callback once, at deadline
+    void runAt(Clock::time_point deadline, Callback callback);
+
+    // Dispatch until stop()
+    void run();
+
+    // Any thread
+    void stop();
+    // Call callback on the loop thread as soon as possible
+    void post(Callback callback);
+
+private:
+    struct Timer
+    {
+        Clock::time_point deadline;
+        std::uint64_t sequence; // FIFO among equal deadlines
+        Callback callback;
+
+        bool operator>(const Timer& other) const
+        {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+    struct Watch
+    {
+        int fd;
+        Callback onReadable;
+    };
+
+    void wake();
+    void drainWakePipe();
+    void runPosted();
+    void runDueTimers();
+
+    int m_wakePipe[2]{-1, -1};
+    std::vector<Watch> m_watches;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+    std::uint64_t m_timerSequence{0};
+    bool m_stopping{false};
+
+    std::mutex m_mutex; // guards m_posted and m_stopRequested
+    std::vector<Callback> m_posted;
+    bool m_stopRequested{false};
+};
+
+#endif
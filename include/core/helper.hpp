@@ -1,8 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <random>
+#include <string>
+#include <string_view>
 
 #include "track.hpp"
 
@@ -12,4 +16,13 @@ namespace helper
 
     // Generate a random integer in the range [x, y]
     int randomInt(int x, int y);
+
+    // Time between two characters of a track, spreading its content over its duration
+    std::chrono::steady_clock::duration contentInterval(const Track& track);
+
+    // Lower-case ASCII letters, trim and collapse runs of whitespace into a single space
+    std::string normalize(std::string_view s);
+
+    // 64-bit FNV-1a hash of the file content, nothing if it cannot be read
+    std::optional<std::uint64_t> fileHash(const std::filesystem::path& path);
 }
\ No newline at end of file
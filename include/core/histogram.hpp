@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// HDR-style histogram of non-negative integers (e.g. microseconds): each power of two range is split into
+// SubBucketCount linear buckets, so any value is recorded with a relative error below 1/SubBucketCount,
+// in constant memory and time. record() is wait-free and can be called from any thread; the readers see
+// a recent, not necessarily consistent, state.
+class Histogram
+{
+public:
+    static constexpr unsigned SubBucketBits = 4;
+    static constexpr unsigned SubBucketCount = 1u << SubBucketBits;
+    static constexpr unsigned BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+    Histogram();
+
+    void record(std::uint64_t value);
+    void reset();
+
+    std::uint64_t count() const;
+    std::uint64_t max() const;
+    double mean() const;
+    // Highest value of the bucket holding the given percentile (0-100), 0 if empty
+    std::uint64_t percentile(double p) const;
+
+    // name count mean p50 p90 p99 p99.9 max, on one line
+    void print(std::ostream& out, std::string_view name) const;
+    static void printHeader(std::ostream& out);
+
+private:
+    static unsigned bucketOf(std::uint64_t value);
+    static std::uint64_t highestValueOf(unsigned bucket);
+
+    std::array<std::atomic<std::uint64_t>, BucketCount> m_buckets;
+    std::atomic<std::uint64_t> m_count;
+    std::atomic<std::uint64_t> m_sum;
+    std::atomic<std::uint64_t> m_max;
+};
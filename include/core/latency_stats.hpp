@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Latency samples grouped by name, summarized as percentiles. Not thread-safe: record on one thread and
+// read once it is done.
+class LatencyStats
+{
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    struct Summary
+    {
+        std::size_t count{0};
+        Duration p50{0};
+        Duration p90{0};
+        Duration p99{0};
+        Duration max{0};
+    };
+
+    void record(const std::string& name, Duration latency);
+
+    // Empty name: all the samples
+    Summary summary(const std::string& name = {}) const;
+    std::size_t count() const;
+
+    // One line per name then the total, in microseconds
+    void report(std::ostream& out) const;
+
+private:
+    static Summary summarize(std::vector<Duration> samples);
+
+    std::map<std::string, std::vector<Duration>> m_samples;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include "playlist.hpp"
+
+// Compiled binary form of a playlist and its tracks, loaded by mapping a single file.
+//
+// Layout (native little-endian, all offsets from the start of the file):
+//   Header       magic, version, counts, playlist name/description and the offsets of the sections below
+//   String table every distinct path/title/artist/codec string, stored once
+//   Records      one fixed-size TrackRecord per track, in playlist order
+//   Content blob the contents of all tracks, back to back
+//
+// The text playlist and track files remain the source of truth: load() followed by
+// Playlist::exportToFile() gives back the playlist file compiled by compile().
+namespace library
+{
+    inline const char* const FileExtension = ".implib";
+
+    // Write the playlist and all its tracks to path, through a temporary file renamed over it, so that
+    // a playlist loaded from path can be compiled back to it. Return false on I/O error.
+    bool compile(const Playlist& playlist, const std::filesystem::path& path);
+
+    // Map path and build a playlist whose tracks are views into the mapping, indexing their content for
+    // search() if indexContent. Return nullptr if the file is not a valid library file.
+    std::shared_ptr<Playlist> load(const std::filesystem::path& path, bool indexContent = false);
+
+    // Return true if path starts with the library file magic
+    bool isLibraryFile(const std::filesystem::path& path);
+}
@@ -1,6 +1,51 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <sstream>
+#include <string>
+
+#include "enums.hpp"
+#include "console_input.hpp"
+#include "output_sink.hpp"
+
+// Records below this level are compiled out entirely (0: Trace ... 5: Off), see the CMake option
+#ifndef IMPLAYER_MIN_LOG_LEVEL
+#define IMPLAYER_MIN_LOG_LEVEL 0
+#endif
+
+// Leveled logging on top of the OutputSink. The level and the format are read from the environment
+// (IMPLAYER_LOG_LEVEL=trace|debug|info|warn|error|off, IMPLAYER_LOG_FORMAT=console|json) and can be
+// changed at runtime. A record is only formatted if its level is enabled, into a buffer of the calling
+// thread.
+class Logger
+{
+public:
+    static Logger& instance();
+
+    bool enabled(LogLevel level) const
+    {
+        return level >= m_level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel level);
+    LogLevel level() const;
+    void setFormat(LogFormat format);
+    LogFormat format() const;
+
+    // Buffer of the calling thread the macros format into
+    static std::ostringstream& threadBuffer();
+    // Queue the record held by buffer, which is cleared
+    void emit(LogLevel level, OutputStream stream, std::ostringstream& buffer);
+
+private:
+    Logger();
+
+    std::atomic<LogLevel> m_level{LogLevel::Info};
+    std::atomic<LogFormat> m_format{LogFormat::Console};
+    const std::chrono::steady_clock::time_point m_start;
+};
 
 #define BOLD(s) "\x1B[1m" s "\x1B[00m"
 #define ITALIC(s) "\x1B[3m" s "\x1B[00m"
@@ -10,14 +55,37 @@
 #define YELLOW(s) "\x1B[33m" s "\x1B[00m"
 #define CYAN(s) "\x1B[36m" s "\x1B[00m"
 
-#define NEWLINE() std::cout << std::endl
+// Format the message on the calling thread, the OutputSink writer thread writes it
+#define SINK_WRITE(stream, s) do { std::ostringstream sinkStream_; sinkStream_ << s; OutputSink::instance().write(stream, sinkStream_.str()); } while (false)
+
+#define LOG_AT(level, stream, s) \
+    do \
+    { \
+        if constexpr (static_cast<int>(level) >= IMPLAYER_MIN_LOG_LEVEL) \
+        { \
+            auto& logger_ = Logger::instance(); \
+            if (logger_.enabled(level)) \
+            { \
+                auto& buffer_ = Logger::threadBuffer(); \
+                buffer_ << s; \
+                logger_.emit(level, stream, buffer_); \
+            } \
+        } \
+    } while (false)
+
+// Blank line between blocks of console output, nothing in JSON lines
+#define NEWLINE() do { if (Logger::instance().format() == LogFormat::Console) { OutputSink::instance().write(OutputStream::Out, "\n"); } } while (false)
+
+#define TRACE_LOG(s) LOG_AT(LogLevel::Trace, OutputStream::Err, s)
+#define DEBUG_LOG(s) LOG_AT(LogLevel::Debug, OutputStream::Err, s)
 
-#define LOG_COMMAND(command) std::cout << ">>>>> Command: " << BOLD(command) << "<<<<<" << std::endl
-#define LOG(s) std::cout << ITALIC(s) << std::endl
+#define LOG_COMMAND(command) LOG_AT(LogLevel::Info, OutputStream::Out, ">>>>> Command: " << BOLD(command) << "<<<<<")
+#define LOG(s) LOG_AT(LogLevel::Info, OutputStream::Out, ITALIC(s))
 
-#define WARN_MSG(s) std::cerr << BOLD(YELLOW("WARN: ")) << s << std::endl
+#define WARN_MSG(s) LOG_AT(LogLevel::Warn, OutputStream::Err, BOLD(YELLOW("WARN: ")) << s)
 
-#define ERROR_EC_MSG(ec) std::cerr << BOLD(RED("ERROR: ")) << ec.message() << std::endl
-#define ERROR_LOG(err) std::cerr << BOLD(RED("ERROR: ")) << err << std::endl
+#define ERROR_EC_MSG(ec) LOG_AT(LogLevel::Error, OutputStream::Err, BOLD(RED("ERROR: ")) << ec.message())
+#define ERROR_LOG(err) LOG_AT(LogLevel::Error, OutputStream::Err, BOLD(RED("ERROR: ")) << err)
 
-#define PROMPT(str, x) std::cout << str << ": "; std::getline(std::cin, x);
\ No newline at end of file
+// The prompt is written before reading the answer
+#define PROMPT(str, x) SINK_WRITE(OutputStream::Out, str << ": "); OutputSink::instance().flush(); ConsoleInput::instance().readLine(x);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile
+{
+public:
+    // Return nullptr if the file cannot be opened or mapped (e.g. out of mappings)
+    static std::shared_ptr<const MappedFile> open(const std::filesystem::path& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    std::size_t size() const;
+    std::string_view view() const;
+
+    // Hint the OS that the pages holding range (mapped or not) will be read soon
+    static void willNeed(std::string_view range);
+
+private:
+    MappedFile() = default;
+
+    const char* m_data{nullptr};
+    std::size_t m_size{0};
+#ifdef _WIN32
+    void* m_mapping{nullptr};
+#endif
+};
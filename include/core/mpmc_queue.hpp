@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for any number of producer and consumer threads. Each slot carries a sequence
+// number telling whether it is ready for the producer or the consumer of a given round.
+// Capacity must be a power of two.
+template <typename T, std::size_t Capacity>
+class MpmcQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpmcQueue()
+    {
+        for (std::size_t i = 0; i < Capacity; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Return false (and leave item untouched) if the queue is full
+    bool tryPush(T&& item)
+    {
+        auto pos = m_tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& slot = m_slots[pos & (Capacity - 1)];
+            auto diff = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    slot.value = std::move(item);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Return false if the queue is empty
+    bool tryPop(T& item)
+    {
+        auto pos = m_head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& slot = m_slots[pos & (Capacity - 1)];
+            auto diff = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(slot.value);
+                    slot.value = T();
+                    slot.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate when called while other threads are running
+    std::size_t size() const
+    {
+        auto tail = m_tail.load(std::memory_order_acquire);
+        auto head = m_head.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    // Producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::array<Slot, Capacity> m_slots;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "constants.hpp"
+#include "content_writer.hpp"
+#include "enums.hpp"
+#include "mpmc_queue.hpp"
+#include "wakeup_signal.hpp"
+
+enum class OutputStream
+{
+    Out,
+    Err,
+};
+
+// Process-wide asynchronous console output. Any thread queues messages in a bounded lock-free buffer;
+// a dedicated writer thread drains it and writes consecutive messages for the same stream with a single
+// system call. A slow terminal or pipe therefore only delays the writer thread, and producers are only
+// affected when the buffer is full: messages (logs, prompts, state lines) wait for room, the streamed
+// track content follows the BackpressurePolicy, so that it cannot stall the streaming thread.
+class OutputSink
+{
+public:
+    static OutputSink& instance();
+    // Write everything still queued
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // Queue a message, waiting for room if the buffer is full
+    bool write(OutputStream stream, std::string text);
+    // Queue streamed content to stdout, the policy() deciding when the buffer is full. Return false if
+    // text was dropped (BackpressurePolicy::Drop).
+    bool writeContent(std::string text);
+
+    // Wait until everything queued so far is written, e.g. before reading the console or writing to
+    // stdout directly
+    void flush();
+
+    // Policy of writeContent(). Drop by default, IMPLAYER_OUTPUT_POLICY=drop|block|overwrite picks another
+    // one at startup. Overwrite may discard queued messages as well.
+    void setPolicy(BackpressurePolicy policy);
+    BackpressurePolicy policy() const;
+
+    // Number of messages discarded by the Drop and Overwrite policies
+    std::uint64_t droppedCount() const;
+
+private:
+    struct Message
+    {
+        OutputStream stream{OutputStream::Out};
+        std::string text;
+    };
+
+    OutputSink();
+    void writerLoop();
+    void wakeWriter();
+    bool push(Message message, BackpressurePolicy policy);
+    // BackpressurePolicy::Block: sleep until the writer thread makes room
+    void waitAndPush(Message& message);
+    void writeOut(OutputStream stream, std::string& buffer);
+
+    MpmcQueue<Message, OutputSinkCapacity> m_queue;
+    std::atomic<BackpressurePolicy> m_policy{BackpressurePolicy::Drop};
+    std::atomic<std::uint64_t> m_queued{0};
+    std::atomic<std::uint64_t> m_done{0}; // written or overwritten
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<bool> m_writerIdle{false};
+    std::atomic<bool> m_stopping{false};
+    WakeupSignal m_wakeup;
+
+    std::mutex m_spaceMutex;
+    std::condition_variable m_spaceFreed;
+    std::atomic<int> m_blockedProducers{0};
+
+    std::mutex m_flushMutex;
+    std::condition_variable m_flushed;
+
+    ContentWriter m_out{1};
+    ContentWriter m_err{2};
+    std::thread m_writer;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "constants.hpp"
+#include "playback_order.hpp"
+#include "playlist.hpp"
+#include "track_cursor.hpp"
+
+using SessionId = std::uint64_t;
+
+enum class SessionCommand
+{
+    Play,
+    Pause,
+    Next,
+    Previous,
+    Shuffle, // toggle shuffle/unshuffle
+    Repeat,  // switch to the next repeat mode
+};
+
+// Snapshot of a session, as of its last tick
+struct SessionState
+{
+    int currentTrackIndex{PlaybackOrder::NoTrack};
+    bool playing{false};
+    bool shuffled{false};
+    RepeatMode repeatMode{RepeatMode::NoRepeat};
+    std::uint64_t bytesStreamed{0};
+};
+
+// Headless player hosting many independent playback sessions on a fixed pool of worker threads.
+//
+// All sessions stream from one read-only library. Each session only owns a PlaybackOrder (current
+// track, shuffle and repeat state) and a TrackCursor. Sessions are scheduled on
+// their next content deadline: a worker picks the most urgent due session, streams what is due to the
+// session's sink and reschedules it, so thousands of listeners need no thread of their own.
+class PlaybackEngine
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // Receives the content streamed by a session. Called on a worker thread, never concurrently for
+    // the same session.
+    using Sink = std::function<void(SessionId, std::string_view)>;
+
+    // numWorkers == 0 creates one worker per hardware thread
+    explicit PlaybackEngine(std::shared_ptr<const Playlist> library, unsigned numWorkers = 0,
+                            Clock::duration delayBetweenTracks = DelayBetweenTracks);
+    ~PlaybackEngine();
+
+    PlaybackEngine(const PlaybackEngine&) = delete;
+    PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+
+    // New session, stopped on the first track of the library. seed makes its shuffled order reproducible.
+    SessionId openSession(Sink sink, std::optional<unsigned> seed = std::nullopt);
+    void closeSession(SessionId id);
+
+    // Queue a command for the session, applied by a worker right away. Return false for an unknown session.
+    bool post(SessionId id, SessionCommand command);
+
+    std::optional<SessionState> sessionState(SessionId id) const;
+    std::size_t sessionCount() const;
+
+private:
+    struct Session;
+
+    struct ScheduledTick
+    {
+        Clock::time_point deadline;
+        std::uint64_t generation; // stale if the session was rescheduled since
+        std::shared_ptr<Session> session;
+
+        bool operator>(const ScheduledTick& other) const { return deadline > other.deadline; }
+    };
+
+    void workerLoop();
+    // m_mutex must be held
+    void schedule(const std::shared_ptr<Session>& session, Clock::time_point deadline);
+    // Apply the commands and stream what is due. Return the next deadline, nothing if the session is idle.
+    std::optional<Clock::time_point> tick(Session& session, const std::vector<SessionCommand>& commands);
+    void applyCommand(Session& session, SessionCommand command, Clock::time_point now);
+    // Point the session's cursor to the beginning of the given track
+    void seekCurrent(Session& session, int trackIdx);
+
+    const std::shared_ptr<const Playlist> m_library;
+    const Clock::duration m_delayBetweenTracks;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::priority_queue<ScheduledTick, std::vector<ScheduledTick>, std::greater<ScheduledTick>> m_schedule;
+    std::unordered_map<SessionId, std::shared_ptr<Session>> m_sessions;
+    SessionId m_nextSessionId{1};
+    bool m_stopping{false};
+    std::vector<std::thread> m_workers;
+};
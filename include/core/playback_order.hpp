@@ -0,0 +1,71 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "enums.hpp"
+
+// Playback order over the track indices [0, size()): current position, shuffle permutation and repeat
+// mode. It holds no track, so several orders (e.g. one per listening session) can walk the same tracks.
+class PlaybackOrder
+{
+public:
+    // Index value meaning "no track"
+    static constexpr int NoTrack = -1;
+
+    int size() const;
+
+    // Start over with tracks [0, size), the first one being current. The shuffle state is kept.
+    void assign(int size);
+    // Add the track index size() to the order
+    void append();
+    // Remove every track i for which removed[i] is true; the remaining ones are renumbered contiguously
+    void erase(const std::vector<bool>& removed);
+    void clear();
+
+    // Index of the current track, NoTrack if there is none
+    int current() const;
+    // Each return the new current track index
+    int reset();
+    int seek(int trackIdx);
+    int next(bool autoplay);
+    int previous();
+    // Track index next(true) would return, without moving
+    int peekNext() const;
+    // Number of steps (forward or backward, wrapping around with RepeatWholePlaylist) between the current
+    // track and trackIdx in the active order. size() if there is no current track.
+    int distanceFromCurrent(int trackIdx) const;
+    // Track indices at most radius steps away from the current track, i.e. whose distanceFromCurrent()
+    // is at most radius. Empty if there is no current track.
+    std::vector<int> window(int radius) const;
+
+    // Shuffle. The shuffled order is built on the first shuffle, then kept across shuffle()/unshuffle()
+    // and updated by append()/erase(), so that toggling is O(1): shuffle() only moves the current track
+    // to the front. reshuffle() draws a new order, leaving shuffle on or off: when off, the next shuffle()
+    // uses it.
+    bool isShuffled() const;
+    void shuffle();
+    void unshuffle();
+    void reshuffle();
+    // Make the shuffled orders reproducible. An order already drawn is drawn again from the new seed.
+    void seed(unsigned seed);
+
+    RepeatMode repeatMode() const;
+    // Switching repeat mode. Order: NoRepeat -> RepeatAll -> RepeatOne
+    void repeat();
+
+private:
+    // Map a position in the active (shuffled or not) order to a track index and back
+    int trackIndexAt(int pos) const;
+    int positionOf(int trackIdx) const;
+    void buildShuffledOrder();
+    void swapShuffledPositions(int pos1, int pos2);
+
+    int m_size{0};
+    std::vector<int> m_shuffledOrder; // track indices in shuffled order, empty until the first shuffle()/reshuffle()
+    std::vector<int> m_shuffledPos; // inverse of m_shuffledOrder: position of each track in the shuffled order
+    std::mt19937 m_rng{std::random_device{}()};
+    int m_currentPos{NoTrack}; // position of the current track in the active order
+    RepeatMode m_repeatMode{RepeatMode::NoRepeat};
+    bool m_isShuffled{false};
+};
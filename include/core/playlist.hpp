@@ -1,25 +1,56 @@
 #pragma once
 
 #include <vector>
-#include <list>
 #include <string>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 #include <filesystem>
 
 #include "track.hpp"
+#include "track_arena.hpp"
+#include "track_cache.hpp"
 #include "enums.hpp"
+#include "playback_order.hpp"
+#include "track_index.hpp"
 #include "helper.hpp"
+#include "constants.hpp"
 
 namespace fs = std::filesystem;
 
-using TrackPtr = std::shared_ptr<Track>;
-using TrackList = std::list<std::shared_ptr<Track>>;
-using TrackListIterator = TrackList::iterator;
+using TrackPtr = std::shared_ptr<const Track>;
+using TrackList = std::vector<TrackPtr>;
+
+struct ImportOptions
+{
+    // Number of threads parsing track files. 1 parses on the calling thread, 0 uses one per hardware thread.
+    unsigned numThreads{1};
+    TrackLoadMode loadMode{TrackLoadMode::Copy};
+    // Allocate the tracks and their buffers in the playlist's arena instead of one by one.
+    // Ignored for the tracks going through the TrackCache.
+    bool useArena{true};
+    // Share the tracks already loaded from the same unchanged files, see TrackCache. Off by default: the
+    // cached tracks are allocated one by one, since an arena would only be freed with all its tracks.
+    bool useCache{false};
+    // Also index the words of the content for search(), not only the title and the artist. The tracks
+    // are split into words on the loading threads; lazy tracks have their content read once more.
+    bool indexContent{false};
+};
+
+// Changes found by Playlist::rescanFolder()
+struct FolderDiff
+{
+    std::vector<fs::path> added;
+    std::vector<fs::path> removed;
+    std::vector<fs::path> updated;
+};
 
 class Playlist
 {
 public:
+    // Index value meaning "no track"
+    static constexpr int NoTrack = PlaybackOrder::NoTrack;
+
     Playlist() = default;
     ~Playlist() = default;
 
@@ -30,9 +61,18 @@ public:
     const std::string& description() const;
     const TrackList & tracks() const;
 
-    // Return the number of tracks added to the playlist
-    int importFromFolder(std::filesystem::path path);
-    int importFromFile(std::filesystem::path path);
+    // Return the number of tracks added to the playlist. Tracks keep the order of the file (or the sorted
+    // folder entries) whatever the number of threads used; tracks failing to load are skipped and recorded.
+    int importFromFolder(std::filesystem::path path, const ImportOptions& options = {});
+    int importFromFile(std::filesystem::path path, const ImportOptions& options = {});
+    // Bring the playlist up to date with the folder of the last importFromFolder(): only the added
+    // files and the ones whose size, modification time and then content hash changed are parsed.
+    // Updated tracks keep their place, added ones are appended, removed ones are dropped. The tracks it
+    // loads do not go to the arena (options.useArena is ignored), so that repeated rescans free the
+    // tracks they replace.
+    FolderDiff rescanFolder(const ImportOptions& options = {});
+    // Track files which could not be loaded by the last import
+    const std::vector<fs::path>& importFailures() const;
     void exportToFile(std::filesystem::path path);
 
     void validate(bool valid);
@@ -41,39 +81,97 @@ public:
     int size() const;
 
     // Reset the pointer to the first track
-    std::shared_ptr<Track> resetToFirstTrack();
+    TrackPtr resetToFirstTrack();
     // Return the pointer to the current track
-    std::shared_ptr<Track> currentTrack();
+    TrackPtr currentTrack();
+    // Return the index in tracks() of the current track, NoTrack if there is none
+    int currentTrackIndex() const;
+    // Make tracks()[trackIdx] the current track, in the current (shuffled or not) order
+    TrackPtr seek(int trackIdx);
     // Switch to the next/previous track
-    std::shared_ptr<Track> nextTrack(bool autoplay);
-    std::shared_ptr<Track> previousTrack();
-
-    // Add track to the playlist
-    void addTrack(std::shared_ptr<Track> track);
+    TrackPtr nextTrack(bool autoplay);
+    TrackPtr previousTrack();
+    // Track nextTrack(true) would return, without moving
+    TrackPtr peekNextTrack() const;
+
+    // Add track to the playlist. Its title and artist are indexed for search(), and its content too if
+    // indexContent.
+    void addTrack(TrackPtr track, bool indexContent = false);
+    // Load the track file and add it to the playlist. Return false if the file could not be loaded.
+    bool addTrackFromFile(std::filesystem::path path, const ImportOptions& options = {});
     // Return true if removal successful. False otherwise
     bool removeTrack(int trackIdx);
 
-    void removeDuplicate();
+    // Keep the first track of each group of duplicates. Return the number of tracks removed.
+    int removeDuplicate(DuplicateKey key = DuplicateKey::TitleArtist);
 
-    // Shuffle
+    // Indices in tracks() of the tracks matching the query (see TrackIndex::search), in increasing order
+    std::vector<int> search(std::string_view query,
+                            std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    // Shuffle, see PlaybackOrder
     bool isShuffled() const;
     void shuffle();
     void unshuffle();
+    void reshuffle();
+    // Make the shuffled orders reproducible
+    void seed(unsigned seed);
 
     // Repeat
     RepeatMode getRepeatMode() const;
     void repeat();
 
+    // Current position, shuffle and repeat state over the indices of tracks()
+    const PlaybackOrder& order() const;
+
     void clear();
+
+    // Lazy tracks (TrackLoadMode::Lazy) farther than the window from the current track in the playback
+    // order get their content evicted by evictContent()
+    void setContentWindow(int window);
+    int contentWindow() const;
+    // Evict the tracks which left the window since the last call, without scanning the playlist: the
+    // contents are expected to be loaded around the current track only. Return the number of tracks evicted.
+    int evictContent();
+
+    // Arena owning the tracks loaded by this playlist. Tracks handed to other playlists keep it alive.
+    std::shared_ptr<TrackArena> arena();
 private:
+    // What rescanFolder() knows about each file of the imported folder
+    struct JournalEntry
+    {
+        std::uintmax_t size{0};
+        fs::file_time_type mtime;
+        std::optional<std::uint64_t> hash; // computed when the size or the time changes, not on import
+        TrackPtr track; // null if the file failed to load
+    };
+
+    int addTracksFromFiles(const std::vector<fs::path>& paths, const ImportOptions& options);
+    // Load the tracks in parallel, result[i] is null if paths[i] failed to load. The loading threads also
+    // index each loaded track under ids[i], while its content is in memory.
+    std::vector<TrackPtr> loadTracks(const std::vector<fs::path>& paths, const std::vector<TrackIndex::Id>& ids,
+                                     const ImportOptions& options);
+    // Append the loaded tracks, record the failures. Return the number of tracks added.
+    int appendLoaded(const std::vector<fs::path>& paths, const std::vector<TrackPtr>& loaded,
+                     const std::vector<TrackIndex::Id>& ids);
+    void appendTrack(TrackPtr track, TrackIndex::Id id);
+    static std::vector<fs::path> listFolder(const fs::path& path);
+    TrackPtr trackAt(int trackIdx) const;
+    // Remove every track i for which removed[i] is true, in a single pass over both orders
+    void eraseTracks(const std::vector<bool>& removed);
+
     std::optional<fs::path> m_path;
     bool m_isValid{false};
     std::string m_name;
     std::string m_description;
     TrackList m_tracks; // A track can be in different playlist, therefore they are included as shared pointers.
-    TrackList m_shuffledPlaylist;
-    TrackListIterator m_currentTrackIter;
-    TrackPtr m_currentTrack;
-    RepeatMode m_repeatMode{RepeatMode::NoRepeat};
-    bool m_isShuffled{false};
+    std::vector<TrackIndex::Id> m_trackIds; // m_trackIds[i] indexes m_tracks[i], increasing
+    TrackIndex m_index;
+    std::shared_ptr<TrackArena> m_arena;
+    PlaybackOrder m_order; // over the indices of m_tracks
+    int m_contentWindow{DefaultContentWindow};
+    TrackList m_windowTracks; // tracks in the content window at the last evictContent()
+    std::vector<fs::path> m_importFailures;
+    std::optional<fs::path> m_folder; // folder of the last importFromFolder()
+    std::unordered_map<std::string, JournalEntry> m_journal; // by path in m_folder
 };
\ No newline at end of file
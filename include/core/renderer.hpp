@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "content_writer.hpp"
+#include "playlist.hpp"
+
+// Offline rendering: the whole playlist is written at full speed, without any pacing, e.g. to generate
+// reference outputs or to measure the raw streaming throughput.
+namespace render
+{
+    struct Options
+    {
+        // Number of passes over a repeating playlist (or renders of its first track in
+        // RepeatMode::RepeatCurrentSong), which would never end otherwise
+        unsigned repeatCount{1};
+    };
+
+    struct Stats
+    {
+        std::size_t tracks{0};
+        std::uint64_t bytes{0};
+        std::chrono::steady_clock::duration elapsed{};
+        bool ok{true}; // false if a write failed
+
+        double megabytesPerSecond() const;
+    };
+
+    // Write the content of the tracks, each followed by a newline, in the playlist order (shuffled or
+    // not) from its first track, honoring the repeat mode. The playlist itself is left untouched: lazy
+    // tracks whose content was not loaded are evicted again once written.
+    Stats renderPlaylist(const Playlist& playlist, ContentWriter& writer, const Options& options = {});
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct StringPoolEntry;
+
+// Stable handle to a string stored once for the whole process. Two handles are equal if and only if
+// their strings are equal, so comparing or hashing a handle never touches the characters.
+class InternedString
+{
+public:
+    InternedString() = default; // the empty string
+
+    std::string_view view() const;
+    // Handle of helper::normalize(view()), computed once per distinct string
+    InternedString folded() const;
+    bool empty() const;
+
+    bool operator==(const InternedString& other) const { return m_entry == other.m_entry; }
+    bool operator!=(const InternedString& other) const { return m_entry != other.m_entry; }
+
+private:
+    friend class StringPool;
+    friend struct std::hash<InternedString>;
+    explicit InternedString(const StringPoolEntry* entry) : m_entry(entry) {}
+
+    const StringPoolEntry* m_entry{nullptr};
+};
+
+namespace std
+{
+template <>
+struct hash<InternedString>
+{
+    std::size_t operator()(const InternedString& s) const noexcept
+    {
+        return std::hash<const void*>()(s.m_entry);
+    }
+};
+}
+
+// Process-wide, thread-safe pool of metadata strings (titles, artists, codecs).
+// Strings are never released: the pool is meant for values repeated across a library.
+class StringPool
+{
+public:
+    static StringPool& instance();
+
+    InternedString intern(std::string_view s);
+
+    // Number of distinct strings in the pool
+    std::size_t size() const;
+
+private:
+    StringPool() = default;
+    const StringPoolEntry* internLocked(std::string_view s);
+
+    mutable std::shared_mutex m_mutex;
+    std::deque<StringPoolEntry> m_entries; // never reallocates existing entries
+    std::unordered_map<std::string_view, const StringPoolEntry*> m_index; // keys are views into m_entries
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed number of worker threads executing queued tasks in FIFO order
+class ThreadPool
+{
+public:
+    // numThreads == 0 creates one worker per hardware thread
+    explicit ThreadPool(unsigned numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const;
+
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    // Call fn(i) for every i in [0, count). Workers grab the indices in batches of batchSize
+    // so the queue sees one task per worker instead of one per item. Blocks until done.
+    void parallelFor(std::size_t count, std::size_t batchSize, const std::function<void(std::size_t)>& fn);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_idle;
+    int m_busyWorkers{0};
+    bool m_stopping{false};
+};
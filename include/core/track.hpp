@@ -1,45 +1,110 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 
+#include "enums.hpp"
+#include "string_pool.hpp"
+
+class TrackArena;
+
+// Keeps the content of a track in memory while held, even if the track evicts it meanwhile
+struct ContentPin
+{
+    std::shared_ptr<const void> owner; // null when the track itself owns the content
+    std::string_view content;
+};
+
+// A track is immutable once published in a playlist (the setters are only meant for building it), so
+// it can be shared between threads without locking. Playback positions live in TrackCursor.
 class Track
 {
 public:
     Track() = default;
     ~Track() = default;
 
-    bool initFromFile(std::filesystem::path path);
+    // Metadata is interned in the StringPool. In TrackLoadMode::MemoryMapped the content is a view into
+    // a mapping of the file; files under MinMappedFileSize, and files that cannot be mapped (logged
+    // once), are loaded with TrackLoadMode::Copy instead.
+    // In TrackLoadMode::Copy the file is read into arena when given, into a buffer of its own otherwise.
+    // In TrackLoadMode::Lazy only the keys before content are read, content being the last key of the
+    // track file; the track falls back to TrackLoadMode::Copy if other keys follow it.
+    bool initFromFile(std::filesystem::path path, TrackLoadMode mode = TrackLoadMode::Copy,
+                      TrackArena* arena = nullptr);
+
+    // The content is a view kept valid by buffer (e.g. the mapping of a compiled library file)
+    void initFromFields(std::string_view path, std::string_view title, std::string_view artist,
+                        std::string_view codec, int durationMs, std::string_view content,
+                        std::shared_ptr<const void> buffer);
 
     // Getters
     std::string path() const;
 
-    const std::string& title() const;
+    std::string_view title() const;
+
+    std::string_view artist() const;
 
-    const std::string& artist() const;
+    std::string_view codec() const;
 
-    const std::string& codec() const;
+    // Interned metadata, for comparisons and hashing without touching the strings
+    InternedString titleHandle() const;
+    InternedString artistHandle() const;
+    InternedString codecHandle() const;
 
     int duration() const;
 
-    const std::string& content() const;
+    // Content of a lazy track is loaded on first use. The view stays valid until evictContent() is
+    // called, use pinContent() where that may happen on another thread.
+    std::string_view content() const;
+    ContentPin pinContent() const;
+    // Content length, without loading it
+    std::size_t contentSize() const;
 
-    char streamCurrentContent();
+    // Lazy tracks only: drop the loaded content, read again from the file on next use. Thread-safe.
+    // Return false if there was nothing to drop.
+    bool evictContent() const;
+    bool isContentLoaded() const;
 
-    void resetCurrentContentIndex();
+    // Load the content and fault in its pages (e.g. from a mapped file) so that streaming it does not
+    // wait for I/O. Meant to run ahead of playback on a background thread.
+    void prefetch() const;
 
-    bool endOfTrack() const;
+    // Setters. The new value is interned or copied, the loaded file buffer is left untouched.
+    void setTitle(std::string_view title);
+    void setArtist(std::string_view artist);
+    void setCodec(std::string_view codec);
+    void setContent(std::string_view content);
 
 private:
-    bool parseKeyValue(const std::string& key, const std::string& val);
+    static InternedString defaultArtist();
+    bool parseKeyValue(std::string_view key, std::string_view val);
+    // One "key value" per line, the value running to the end of the line ('\r' excluded). Empty lines
+    // are skipped, and a key alone on its line gets an empty value. Return false on an unknown key.
+    bool parse(std::string_view text);
+    // Return false if the file cannot be read, nothing if it must be loaded with another mode
+    std::optional<bool> initLazy(const std::filesystem::path& path);
+    std::string_view ownCopy(std::string_view value);
 
     std::filesystem::path m_path;
-    std::string m_title;
-    std::string m_artist{"unknown"};
-    std::string m_codec;
+    // The content is a view into m_buffer (the file loaded or mapped), into m_editedFields or into the
+    // arena owning the track. All are shared and never reallocated, so copying a Track keeps the view valid.
+    std::shared_ptr<const void> m_buffer;
+    std::vector<std::shared_ptr<const std::string>> m_editedFields;
+    InternedString m_title;
+    InternedString m_artist{defaultArtist()};
+    InternedString m_codec;
     int m_durationMs{0}; // track duration in milliseconds
-    std::string m_content;
-    int m_currentContentIndex{0}; // a cursor to the current position in the track content
-    bool m_endOfTrack{false};
-};
\ No newline at end of file
+    std::string_view m_content;
+
+    // TrackLoadMode::Lazy: location of the content in the file at m_path, and the content once loaded,
+    // accessed with the atomic shared_ptr functions
+    bool m_isLazy{false};
+    std::uint64_t m_lazyOffset{0};
+    std::size_t m_lazySize{0};
+    mutable std::shared_ptr<const std::string> m_lazyContent;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "track.hpp"
+
+// Slab allocator for Track objects and their file buffers. Tracks are constructed in slabs of
+// TracksPerSlab and buffers are carved out of large blocks, so a bulk import makes a few large
+// allocations instead of several small ones per track.
+//
+// The pointers returned by newTrack() share the ownership of the whole arena: they can be handed to
+// any number of playlists, and the arena with all its tracks is released at once with the last one.
+// Nothing is reclaimed before: the tracks a playlist removes (removeTrack, removeDuplicate) keep their
+// slot and their buffer, the arena only grows. Playlist::rescanFolder(), which replaces tracks over and
+// over, allocates its tracks outside of the arena for that reason. Playlist::clear() drops the arena.
+class TrackArena : public std::enable_shared_from_this<TrackArena>
+{
+public:
+    static constexpr std::size_t TracksPerSlab = 1024;
+    static constexpr std::size_t BytesPerBlock = 1 << 20;
+
+    static std::shared_ptr<TrackArena> create();
+    ~TrackArena();
+
+    TrackArena(const TrackArena&) = delete;
+    TrackArena& operator=(const TrackArena&) = delete;
+
+    // Construct an empty track in the arena. Thread-safe.
+    std::shared_ptr<Track> newTrack();
+    // Move a track loaded beforehand into the arena, so that failed loads take no slot. Thread-safe.
+    std::shared_ptr<Track> newTrack(Track&& track);
+
+    // Return size bytes living as long as the arena. Thread-safe.
+    char* allocate(std::size_t size);
+    // Give back the bytes of allocate() (e.g. a file which failed to parse). Only the last allocation
+    // is reclaimed, the bytes of older ones stay with the arena. Thread-safe.
+    void deallocate(char* data, std::size_t size);
+
+    std::size_t trackCount() const;
+    std::size_t bytesAllocated() const;
+
+private:
+    using TrackStorage = std::aligned_storage_t<sizeof(Track), alignof(Track)>;
+
+    TrackArena() = default;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<TrackStorage[]>> m_trackSlabs;
+    std::size_t m_trackCount{0};
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* m_blockCursor{nullptr};
+    std::size_t m_blockRemaining{0};
+    std::size_t m_bytesAllocated{0};
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "constants.hpp"
+#include "enums.hpp"
+#include "track.hpp"
+
+// Process-wide, thread-safe cache of loaded tracks, keyed by canonical path and load mode. An entry is
+// reused as long as the file keeps its modification time and size, so re-importing a file or switching
+// between playlists sharing track files does not read them again.
+//
+// Entries are charged the heap memory their track holds or may hold once its content is loaded (not the
+// mapped files), and the least recently used ones are dropped when the total goes over the budget. Tracks stay valid in the playlists still
+// holding them.
+class TrackCache
+{
+public:
+    static TrackCache& instance();
+
+    // Return the cached track for path, or load and cache it. nullptr if the file cannot be loaded.
+    std::shared_ptr<const Track> load(const std::filesystem::path& path, TrackLoadMode mode);
+
+    void setBudget(std::size_t bytes);
+    std::size_t budget() const;
+    std::size_t bytesUsed() const;
+    std::size_t size() const;
+    std::uint64_t hits() const;
+    std::uint64_t misses() const;
+
+    void clear();
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::filesystem::file_time_type mtime;
+        std::uintmax_t fileSize{0};
+        std::size_t bytes{0};
+        std::shared_ptr<const Track> track;
+    };
+
+    TrackCache() = default;
+    // m_mutex must be held
+    void evictOverBudget();
+
+    mutable std::mutex m_mutex;
+    std::list<Entry> m_lru; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    std::size_t m_budget{DefaultTrackCacheBudget};
+    std::size_t m_bytesUsed{0};
+    std::uint64_t m_hits{0};
+    std::uint64_t m_misses{0};
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+#include "track.hpp"
+
+// Playback position in a track. Tracks are immutable and shared between playlists, players and
+// sessions: each reader streams through its own cursor, so they never see each other's position.
+class TrackCursor
+{
+public:
+    TrackCursor() = default;
+    explicit TrackCursor(std::shared_ptr<const Track> track);
+
+    // Point to the beginning of track (which may be null), loading its content if needed
+    void reset(std::shared_ptr<const Track> track);
+    // Back to the beginning of the current track
+    void rewind();
+
+    const std::shared_ptr<const Track>& track() const;
+
+    // Return the next character of the content, 0 at the end of the track
+    char next();
+    // Return the next count characters (fewer at the end of the track) and move past them
+    std::string_view take(std::size_t count);
+    // Return the content played during slice at the track's pace (see helper::contentInterval), at
+    // least one character unless at the end of the track, and move past it
+    std::string_view takeFor(std::chrono::steady_clock::duration slice);
+    // Content not streamed yet
+    std::string_view remaining() const;
+
+    std::size_t position() const;
+    bool endOfTrack() const;
+
+private:
+    std::shared_ptr<const Track> m_track;
+    ContentPin m_pin; // keeps the content loaded, lazy tracks may evict theirs meanwhile
+    std::size_t m_position{0};
+};
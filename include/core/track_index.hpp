@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Track;
+
+// Inverted index over the words of the title, the artist and optionally the content of tracks.
+// Words are the runs of letters and digits (bytes above 0x7F included, so UTF-8 words stay whole),
+// compared case-insensitively. Each track gets an Id when added; the Ids only grow, so they can keep
+// the order of a playlist that only appends tracks. Erased tracks and the words no track has any more
+// free their memory.
+// Callers serialize the changes; searches may run concurrently with each other.
+class TrackIndex
+{
+public:
+    using Id = std::uint32_t;
+    // Words of a track, each once
+    using Words = std::vector<std::string>;
+
+    // Words of the title, the artist and, if withContent, the content. A lazy track gets its content
+    // loaded then evicted again. Thread-safe: the import splits the tracks on its loading threads.
+    static Words wordsOf(const Track& track, bool withContent);
+
+    // Index the words of a track under a new Id, greater than all the previous ones
+    Id add(const Words& words);
+    // New Ids, increasing, to index tracks with replace() (e.g. in any order while loading them)
+    std::vector<Id> reserveIds(std::size_t count);
+    // Index the words of a track under id, instead of what it had (e.g. the file changed)
+    void replace(Id id, const Words& words);
+    // Ids must be sorted
+    void erase(const std::vector<Id>& ids);
+    void clear();
+
+    // Ids of the tracks matching every word of the query, sorted, at most limit of them. A word ending
+    // with '*' matches the words starting with it, the others match whole words.
+    std::vector<Id> search(std::string_view query,
+                           std::size_t limit = std::numeric_limits<std::size_t>::max()) const;
+
+    std::size_t wordCount() const;
+
+private:
+    using WordId = std::uint32_t;
+
+    void index(Id id, const Words& words);
+    // Sorted Ids of the tracks with a word starting with prefix, the first limit of them
+    std::vector<Id> matchPrefix(const std::string& prefix, std::size_t limit) const;
+    // Drop the words no track has any more from the tables
+    void dropUnusedWords();
+
+    std::unordered_map<std::string, WordId> m_words;
+    // The words in lexicographic order, for the prefix queries. The words added since the last prefix
+    // query are only appended: the next one sorts and merges them in, under m_sortMutex.
+    mutable std::vector<std::pair<std::string_view, WordId>> m_sortedWords;
+    mutable std::size_t m_sortedCount{0};
+    mutable std::mutex m_sortMutex;
+    std::vector<std::vector<Id>> m_postings; // by WordId, sorted
+    std::size_t m_unusedWords{0}; // still in the tables, without postings
+    std::vector<WordId> m_freeWordIds; // of the dropped words, reused first
+    std::unordered_map<Id, std::vector<WordId>> m_wordsOfTrack; // to erase without the track
+    Id m_nextId{0};
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Lets one thread sleep until a deadline while other threads can wake it up early.
+// A notify() that happens before the wait is not lost: the next wait returns immediately.
+class WakeupSignal
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Return true if woken up by notify(), false if the deadline was reached
+    bool waitUntil(Clock::time_point deadline);
+    // Wait without deadline
+    void wait();
+
+    void notify();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_notified{false};
+};
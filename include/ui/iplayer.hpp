@@ -19,6 +19,12 @@ public:
     virtual void removeTrack() = 0;
     virtual void removeDuplicate() = 0;
 
+    // Write the whole playlist at full speed, without pacing
+    virtual void renderPlaylist() = 0;
+
+    // Find the tracks matching a query over title, artist and content, and jump to one of them
+    virtual void searchTrack() = 0;
+
     // Info
     virtual void currentPlaylistInfo() = 0;
     virtual void currentTrackInfo() = 0;
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "core/enums.hpp"
+#include "core/playlist.hpp"
+
+enum class PlayerCommandType
+{
+    None,
+    Play,
+    Pause,
+    Next,
+    Previous,
+    Shuffle,
+    Repeat,
+    PlaylistInfo,
+    TrackInfo,
+    Stats,
+    SetPlaylist,     // playlist
+    SavePlaylist,    // argument: destination path
+    AddTrack,        // argument: track file path
+    RemoveTrack,     // index: 1-based track index
+    RemoveDuplicate, // duplicateKey
+    Render,          // argument: destination path, standard output if empty; index: repeat count
+    Search,          // argument: query
+    Quit,
+};
+
+// Command sent by the input thread to the streaming thread, which owns the player state
+struct PlayerCommand
+{
+    PlayerCommandType type{PlayerCommandType::None};
+    std::string argument;
+    std::shared_ptr<Playlist> playlist;
+    int index{0};
+    DuplicateKey duplicateKey{DuplicateKey::TitleArtist};
+    // Set by the input thread, for the latency stats
+    std::chrono::steady_clock::time_point keyPressedAt; // when the key of the command was handled
+    std::chrono::steady_clock::time_point postedAt; // after its prompts and the work of the input thread
+};
+
+inline const char* toString(PlayerCommandType type)
+{
+    switch (type)
+    {
+    case PlayerCommandType::Play: return "play";
+    case PlayerCommandType::Pause: return "pause";
+    case PlayerCommandType::Next: return "next";
+    case PlayerCommandType::Previous: return "previous";
+    case PlayerCommandType::Shuffle: return "shuffle";
+    case PlayerCommandType::Repeat: return "repeat";
+    case PlayerCommandType::PlaylistInfo: return "playlist-info";
+    case PlayerCommandType::TrackInfo: return "track-info";
+    case PlayerCommandType::Stats: return "stats";
+    case PlayerCommandType::SetPlaylist: return "set-playlist";
+    case PlayerCommandType::SavePlaylist: return "save-playlist";
+    case PlayerCommandType::AddTrack: return "add-track";
+    case PlayerCommandType::RemoveTrack: return "remove-track";
+    case PlayerCommandType::RemoveDuplicate: return "remove-duplicate";
+    case PlayerCommandType::Render: return "render";
+    case PlayerCommandType::Search: return "search";
+    case PlayerCommandType::Quit: return "quit";
+    default: return "none";
+    }
+}
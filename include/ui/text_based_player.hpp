@@ -1,10 +1,23 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <istream>
+#include <thread>
 
 #include "iplayer.hpp"
+#include "player_command.hpp"
+#include "core/constants.hpp"
+#include "core/histogram.hpp"
+#include "core/latency_stats.hpp"
+#include "core/spsc_queue.hpp"
+#include "core/thread_pool.hpp"
+#include "core/track_cursor.hpp"
+#include "core/wakeup_signal.hpp"
 
+// The input thread (startCommandHandler) only reads the keyboard and posts PlayerCommands. The streaming
+// thread owns the playlist and the playback state: it applies the pending commands between two ticks of
+// content, so the Player methods below that change the state are only called on that thread.
+// Ticks are scheduled on steady_clock deadlines; posting a command wakes the streaming thread up at once.
 class TextBasedPlayer : public Player
 {
 public:
@@ -13,6 +26,7 @@ public:
     TextBasedPlayer() = default;
     ~TextBasedPlayer();
 
+    // Input thread: prompt for the parameters and post the command
     // Return the number of valid track imported
     int importPlaylist() override;
     void createPlaylist() override;
@@ -21,7 +35,10 @@ public:
     void addTrack() override;
     void removeTrack() override;
     void removeDuplicate() override;
+    void renderPlaylist() override;
+    void searchTrack() override;
 
+    // Streaming thread
     // Info
     void currentPlaylistInfo() override;
     void currentTrackInfo() override;
@@ -39,18 +56,58 @@ public:
     void init() override;
     void run() override;
     void terminate() override;
+
+    // Run the player on a command trace instead of the keyboard, one command per line:
+    //   <milliseconds since the start> <key>
+    // followed by the answers to the prompts of that key, one per line, each starting with '>'.
+    // Empty lines and lines starting with '#' are skipped. realTime false replays as fast as possible.
+    // Return the latency of the commands, from handling their key to applied by the streaming thread.
+    LatencyStats replay(std::istream& trace, bool realTime);
 private:
     void printHelp();
+    // Read the keys until Quit or the end of the input
     void startCommandHandler();
+    // Return false once the player should stop reading keys
+    bool handleKey(int key);
+    void postCommand(PlayerCommand&& command);
+
+    void streamingLoop();
+    void processCommands();
+    void applyCommand(PlayerCommand& command);
     void streamCurrentSong();
+    // Have the content of the track coming after the current one ready before the transition
+    void prefetchNextTrack();
+    void render(const std::string& path, unsigned repeatCount);
+    // Make the first match after the current track the current one, so that searching again cycles
+    // through the matches
+    void jumpToMatch(const std::string& query);
+    void printStats();
+    void writeStats(std::ostream& out) const;
+
     std::shared_ptr<Playlist> m_playlist;
-    bool m_isPlaying{false};
-    bool m_isRunning{false};
+    std::atomic<bool> m_isPlaying{false};
+    std::atomic<bool> m_isRunning{false};
 
-    std::shared_ptr<Track> m_currentTrack;
-    bool m_trackAvailable{true};
+    TrackCursor m_cursor; // current track and position in it
+    TrackPtr m_prefetched; // next track in the playback order
+    ThreadPool m_prefetcher{1};
 
     std::thread m_streamingThread;
-    std::condition_variable m_cv;
-    std::mutex m_mutex;
-};
\ No newline at end of file
+    SpscQueue<PlayerCommand, CommandQueueCapacity> m_commands;
+    WakeupSignal m_wakeup;
+    std::chrono::steady_clock::time_point m_nextTick;
+    LatencyStats* m_latencies{nullptr}; // recorded by the streaming thread when set
+    std::chrono::steady_clock::time_point m_keyPressedAt; // of the key being handled by the input thread
+
+    // Recorded by the streaming thread, in microseconds. Printed by the Stats command and written to
+    // $IMPLAYER_METRICS_FILE on exit.
+    struct Metrics
+    {
+        Histogram commandLatency; // from posting to applied
+        Histogram queueDepth; // commands waiting when the streaming thread drains the queue
+        Histogram tickLateness; // from the deadline of a tick to when it runs
+        Histogram transitionTime; // to switch to another track and have its content ready
+    };
+    Metrics m_metrics;
+    std::string m_metricsFile;
+};
@@ -0,0 +1,206 @@
+#include <iostream>
+#include "core/console_input.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+    // Copy of the raw mode state for the signal handler, which cannot reach the instance safely
+    termios savedModeForSignals{};
+    volatile std::sig_atomic_t isRawForSignals = 0;
+
+    // The terminal keeps ISIG in raw mode: Ctrl-C, or any other terminating signal, must not leave the
+    // shell without echo. Restore the mode, then let the default action of the signal run.
+    void restoreModeOnSignal(int signo)
+    {
+        if (isRawForSignals)
+        {
+            tcsetattr(ConsoleInput::Fd, TCSANOW, &savedModeForSignals);
+        }
+        std::signal(signo, SIG_DFL);
+        std::raise(signo);
+    }
+
+    void installSignalHandlers()
+    {
+        static bool installed = false;
+        if (installed)
+        {
+            return;
+        }
+        installed = true;
+        for (int signo : {SIGINT, SIGQUIT, SIGTERM, SIGHUP})
+        {
+            struct sigaction action{};
+            if (sigaction(signo, nullptr, &action) != 0 || action.sa_handler != SIG_DFL)
+            {
+                // Ignored or handled by someone else
+                continue;
+            }
+            action.sa_handler = restoreModeOnSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = 0;
+            sigaction(signo, &action, nullptr);
+        }
+    }
+}
+#endif
+
+ConsoleInput& ConsoleInput::instance()
+{
+    static ConsoleInput input;
+    return input;
+}
+
+void ConsoleInput::setScripted(bool scripted)
+{
+    m_isScripted = scripted;
+    m_scripted.clear();
+}
+
+void ConsoleInput::pushScriptedLine(std::string line)
+{
+    m_scripted.push_back(std::move(line));
+}
+
+bool ConsoleInput::readLine(std::string& line)
+{
+    if (!m_isScripted)
+    {
+        return readConsoleLine(line);
+    }
+    line.clear();
+    if (m_scripted.empty())
+    {
+        return false;
+    }
+    line = std::move(m_scripted.front());
+    m_scripted.pop_front();
+    return true;
+}
+
+#ifdef _WIN32
+ConsoleInput::~ConsoleInput() = default;
+
+bool ConsoleInput::readConsoleLine(std::string& line)
+{
+    return static_cast<bool>(std::getline(std::cin, line));
+}
+#else
+ConsoleInput::~ConsoleInput()
+{
+    restoreMode();
+}
+
+void ConsoleInput::enableRawMode()
+{
+    if (m_isRaw || !isatty(Fd) || tcgetattr(Fd, &m_savedMode) != 0)
+    {
+        return;
+    }
+    auto raw = m_savedMode;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    savedModeForSignals = m_savedMode;
+    installSignalHandlers();
+    m_isRaw = tcsetattr(Fd, TCSANOW, &raw) == 0;
+    isRawForSignals = m_isRaw;
+}
+
+void ConsoleInput::restoreMode()
+{
+    if (m_isRaw)
+    {
+        isRawForSignals = 0;
+        tcsetattr(Fd, TCSANOW, &m_savedMode);
+        m_isRaw = false;
+    }
+}
+
+bool ConsoleInput::readMore()
+{
+    char buffer[256];
+    while (true)
+    {
+        auto count = ::read(Fd, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            m_pending.append(buffer, count);
+            return true;
+        }
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return false;
+    }
+}
+
+bool ConsoleInput::readAvailable()
+{
+    pollfd fd{Fd, POLLIN, 0};
+    bool any = false;
+    while (::poll(&fd, 1, 0) > 0 && (fd.revents & (POLLIN | POLLHUP | POLLNVAL)))
+    {
+        if (fd.revents & POLLNVAL)
+        {
+            // Closed descriptor, nothing will ever be read
+            return false;
+        }
+        if (!readMore())
+        {
+            return any;
+        }
+        any = true;
+    }
+    return true;
+}
+
+bool ConsoleInput::nextKey(char& key)
+{
+    if (m_pending.empty())
+    {
+        return false;
+    }
+    key = m_pending.front();
+    m_pending.erase(0, 1);
+    return true;
+}
+
+bool ConsoleInput::readConsoleLine(std::string& line)
+{
+    bool wasRaw = m_isRaw;
+    restoreMode();
+
+    line.clear();
+    bool ok = true;
+    std::size_t eol;
+    while ((eol = m_pending.find('\n')) == std::string::npos)
+    {
+        if (!readMore())
+        {
+            // Last line without end of line
+            ok = !m_pending.empty();
+            eol = m_pending.size();
+            break;
+        }
+    }
+    line = m_pending.substr(0, eol);
+    m_pending.erase(0, std::min(eol + 1, m_pending.size()));
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+
+    if (wasRaw)
+    {
+        enableRawMode();
+    }
+    return ok;
+}
+#endif
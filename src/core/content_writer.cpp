@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cerrno>
+#include <vector>
+#include "core/content_writer.hpp"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+ContentWriter::ContentWriter(int fd)
+    : m_fd(fd)
+{
+}
+
+ContentWriter::~ContentWriter()
+{
+    close();
+}
+
+bool ContentWriter::open(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    int fd = ::_wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0)
+    {
+        return false;
+    }
+    close();
+    m_fd = fd;
+    m_ownsFd = true;
+    return true;
+}
+
+void ContentWriter::close()
+{
+    if (m_ownsFd)
+    {
+#ifdef _WIN32
+        ::_close(m_fd);
+#else
+        ::close(m_fd);
+#endif
+        m_ownsFd = false;
+    }
+}
+
+bool ContentWriter::write(std::string_view chunk)
+{
+    while (!chunk.empty())
+    {
+#ifdef _WIN32
+        auto written = ::_write(m_fd, chunk.data(), static_cast<unsigned>(chunk.size()));
+#else
+        auto written = ::write(m_fd, chunk.data(), chunk.size());
+#endif
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        m_bytesWritten += static_cast<std::uint64_t>(written);
+        chunk.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+}
+
+bool ContentWriter::write(const std::string_view* chunks, std::size_t count)
+{
+#ifdef _WIN32
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (!write(chunks[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+#else
+    std::vector<iovec> iov;
+    iov.reserve(std::min<std::size_t>(count, IOV_MAX));
+    std::size_t next = 0;
+    while (next < count)
+    {
+        iov.clear();
+        for (; next < count && iov.size() < IOV_MAX; ++next)
+        {
+            if (!chunks[next].empty())
+            {
+                iov.push_back({const_cast<char*>(chunks[next].data()), chunks[next].size()});
+            }
+        }
+
+        std::size_t first = 0;
+        while (first < iov.size())
+        {
+            auto written = ::writev(m_fd, iov.data() + first, static_cast<int>(iov.size() - first));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            m_bytesWritten += static_cast<std::uint64_t>(written);
+
+            // Skip what went out, a partial write can stop in the middle of a chunk
+            auto remaining = static_cast<std::size_t>(written);
+            while (first < iov.size() && remaining >= iov[first].iov_len)
+            {
+                remaining -= iov[first].iov_len;
+                ++first;
+            }
+            if (first < iov.size())
+            {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+                iov[first].iov_len -= remaining;
+            }
+        }
+    }
+    return true;
+#endif
+}
+
+std::uint64_t ContentWriter::bytesWritten() const
+{
+    return m_bytesWritten;
+}
@@ -0,0 +1,172 @@
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "core/event_loop.hpp"
+
+EventLoop::EventLoop()
+{
+    // Other threads write a byte to wake the loop up
+    if (::pipe(m_wakePipe) == 0)
+    {
+        for (int fd : m_wakePipe)
+        {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    for (int fd : m_wakePipe)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+    }
+}
+
+void EventLoop::watch(int fd, Callback onReadable)
+{
+    unwatch(fd);
+    m_watches.push_back({fd, std::move(onReadable)});
+}
+
+void EventLoop::unwatch(int fd)
+{
+    m_watches.erase(std::remove_if(m_watches.begin(), m_watches.end(),
+                                   [fd](const Watch& watch) { return watch.fd == fd; }),
+                    m_watches.end());
+}
+
+void EventLoop::runAt(Clock::time_point deadline, Callback callback)
+{
+    m_timers.push({deadline, m_timerSequence++, std::move(callback)});
+}
+
+void EventLoop::stop()
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    wake();
+}
+
+void EventLoop::post(Callback callback)
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_posted.push_back(std::move(callback));
+    }
+    wake();
+}
+
+void EventLoop::wake()
+{
+    char byte = 0;
+    // A full pipe already guarantees a wake-up
+    [[maybe_unused]] auto written = ::write(m_wakePipe[1], &byte, 1);
+}
+
+void EventLoop::drainWakePipe()
+{
+    char buffer[64];
+    while (::read(m_wakePipe[0], buffer, sizeof(buffer)) > 0)
+    {
+    }
+}
+
+void EventLoop::runPosted()
+{
+    std::vector<Callback> posted;
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        posted.swap(m_posted);
+        m_stopping = m_stopping || m_stopRequested;
+    }
+    for (auto& callback : posted)
+    {
+        callback();
+    }
+}
+
+void EventLoop::runDueTimers()
+{
+    auto now = Clock::now();
+    while (!m_stopping && !m_timers.empty() && m_timers.top().deadline <= now)
+    {
+        auto callback = std::move(const_cast<Timer&>(m_timers.top()).callback);
+        m_timers.pop();
+        callback();
+    }
+}
+
+void EventLoop::run()
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_stopping = m_stopRequested;
+    }
+
+    std::vector<pollfd> fds;
+    while (!m_stopping)
+    {
+        int timeoutMs = -1;
+        if (!m_timers.empty())
+        {
+            // Rounded up, waking up early would only spin
+            auto wait = m_timers.top().deadline - Clock::now();
+            auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            timeoutMs = static_cast<int>(std::clamp<decltype(ms)>(ms, 0, 24 * 3600 * 1000));
+        }
+
+        fds.clear();
+        fds.push_back({m_wakePipe[0], POLLIN, 0});
+        for (const auto& watch : m_watches)
+        {
+            fds.push_back({watch.fd, POLLIN, 0});
+        }
+
+        int ready = ::poll(fds.data(), fds.size(), timeoutMs);
+        if (ready < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        if (ready > 0 && fds[0].revents)
+        {
+            drainWakePipe();
+        }
+        runPosted();
+
+        // Callbacks may change the watches, dispatch from the snapshot polled
+        for (std::size_t i = 1; ready > 0 && i < fds.size() && !m_stopping; ++i)
+        {
+            // POLLNVAL (closed descriptor) too, the callback sees the end of the input. Skipping it would
+            // spin, poll() reports it at once every time.
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)))
+            {
+                continue;
+            }
+            auto it = std::find_if(m_watches.begin(), m_watches.end(),
+                                   [fd = fds[i].fd](const Watch& watch) { return watch.fd == fd; });
+            if (it != m_watches.end())
+            {
+                auto callback = it->onReadable; // may unwatch itself
+                callback();
+            }
+        }
+
+        runDueTimers();
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_stopping = m_stopping || m_stopRequested;
+    }
+}
+
+#endif
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
 #include "core/helper.hpp"
+#include "core/constants.hpp"
 
 namespace helper
 {
@@ -9,4 +13,59 @@ int randomInt(int x, int y)
     std::uniform_int_distribution<> distrib(x, y);
     return distrib(rng);
 }
-}
\ No newline at end of file
+
+std::chrono::steady_clock::duration contentInterval(const Track& track)
+{
+    auto length = track.contentSize();
+    if (track.duration() <= 0 || length == 0)
+    {
+        return DelayBetweenContent;
+    }
+
+    std::chrono::steady_clock::duration duration = std::chrono::milliseconds(track.duration());
+    return std::max<std::chrono::steady_clock::duration>(duration / length, MinDelayBetweenContent);
+}
+
+std::string normalize(std::string_view s)
+{
+    std::string result;
+    result.reserve(s.size());
+    bool pendingSpace = false;
+    for (unsigned char c : s)
+    {
+        if (std::isspace(c))
+        {
+            pendingSpace = !result.empty();
+            continue;
+        }
+        if (pendingSpace)
+        {
+            result.push_back(' ');
+            pendingSpace = false;
+        }
+        result.push_back(static_cast<char>(std::tolower(c)));
+    }
+    return result;
+}
+
+std::optional<std::uint64_t> fileHash(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return std::nullopt;
+    }
+
+    std::uint64_t hash = 14695981039346656037ull;
+    char block[64 * 1024];
+    while (in.read(block, sizeof(block)) || in.gcount() > 0)
+    {
+        for (std::streamsize i = 0; i < in.gcount(); ++i)
+        {
+            hash ^= static_cast<unsigned char>(block[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include "core/histogram.hpp"
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::reset()
+{
+    for (auto& bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+unsigned Histogram::bucketOf(std::uint64_t value)
+{
+    if (value < SubBucketCount)
+    {
+        return static_cast<unsigned>(value);
+    }
+    // Highest set bit, then the SubBucketBits bits below it
+    unsigned exponent = 63;
+    while (!(value >> exponent))
+    {
+        --exponent;
+    }
+    unsigned shift = exponent - SubBucketBits;
+    auto subBucket = static_cast<unsigned>((value >> shift) & (SubBucketCount - 1));
+    return (shift + 1) * SubBucketCount + subBucket;
+}
+
+std::uint64_t Histogram::highestValueOf(unsigned bucket)
+{
+    if (bucket < SubBucketCount)
+    {
+        return bucket;
+    }
+    unsigned shift = bucket / SubBucketCount - 1;
+    std::uint64_t lowest = static_cast<std::uint64_t>(SubBucketCount + bucket % SubBucketCount) << shift;
+    return lowest + ((std::uint64_t{1} << shift) - 1);
+}
+
+void Histogram::record(std::uint64_t value)
+{
+    m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    auto max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::uint64_t Histogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    auto count = this->count();
+    return count ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+std::uint64_t Histogram::percentile(double p) const
+{
+    auto count = this->count();
+    if (count == 0)
+    {
+        return 0;
+    }
+    auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(count * p / 100.0)));
+    std::uint64_t seen = 0;
+    for (unsigned bucket = 0; bucket < BucketCount; ++bucket)
+    {
+        seen += m_buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return std::min(highestValueOf(bucket), max());
+        }
+    }
+    return max();
+}
+
+void Histogram::printHeader(std::ostream& out)
+{
+    out << std::left << std::setw(20) << "metric" << std::right << std::setw(10) << "count" << std::setw(10)
+        << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9" << std::setw(10) << "max" << '\n';
+}
+
+void Histogram::print(std::ostream& out, std::string_view name) const
+{
+    out << std::left << std::setw(20) << name << std::right << std::setw(10) << count() << std::fixed
+        << std::setprecision(1) << std::setw(10) << mean() << std::setw(10) << percentile(50) << std::setw(10)
+        << percentile(90) << std::setw(10) << percentile(99) << std::setw(10) << percentile(99.9)
+        << std::setw(10) << max() << '\n';
+}
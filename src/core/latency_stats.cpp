@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <iomanip>
+#include "core/latency_stats.hpp"
+
+void LatencyStats::record(const std::string& name, Duration latency)
+{
+    m_samples[name].push_back(latency);
+}
+
+std::size_t LatencyStats::count() const
+{
+    std::size_t count = 0;
+    for (const auto& [key, samples] : m_samples)
+    {
+        count += samples.size();
+    }
+    return count;
+}
+
+LatencyStats::Summary LatencyStats::summary(const std::string& name) const
+{
+    if (!name.empty())
+    {
+        auto it = m_samples.find(name);
+        return it != m_samples.end() ? summarize(it->second) : Summary{};
+    }
+
+    std::vector<Duration> all;
+    all.reserve(count());
+    for (const auto& [key, samples] : m_samples)
+    {
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    return summarize(std::move(all));
+}
+
+LatencyStats::Summary LatencyStats::summarize(std::vector<Duration> samples)
+{
+    Summary summary;
+    summary.count = samples.size();
+    if (samples.empty())
+    {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    // Nearest rank
+    auto percentile = [&samples](unsigned p)
+    {
+        auto rank = (samples.size() * p + 99) / 100;
+        return samples[std::max<std::size_t>(rank, 1) - 1];
+    };
+    summary.p50 = percentile(50);
+    summary.p90 = percentile(90);
+    summary.p99 = percentile(99);
+    summary.max = samples.back();
+    return summary;
+}
+
+void LatencyStats::report(std::ostream& out) const
+{
+    auto us = [](Duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+    auto line = [&](const std::string& name, const Summary& s)
+    {
+        out << std::left << std::setw(16) << name << std::right << std::setw(8) << s.count << std::fixed
+            << std::setprecision(1) << std::setw(12) << us(s.p50) << std::setw(12) << us(s.p90)
+            << std::setw(12) << us(s.p99) << std::setw(12) << us(s.max) << '\n';
+    };
+
+    out << std::left << std::setw(16) << "command" << std::right << std::setw(8) << "count" << std::setw(12)
+        << "p50 (us)" << std::setw(12) << "p90 (us)" << std::setw(12) << "p99 (us)" << std::setw(12)
+        << "max (us)" << '\n';
+    for (const auto& [name, samples] : m_samples)
+    {
+        line(name, summarize(samples));
+    }
+    line("all", summary());
+}
@@ -0,0 +1,268 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "core/library_file.hpp"
+#include "core/logger.hpp"
+#include "core/mapped_file.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const char Magic[8] = {'I', 'M', 'P', 'L', 'Y', 'L', 'I', 'B'};
+const std::uint32_t Version = 1;
+
+struct StringRef
+{
+    std::uint32_t offset; // in the string table
+    std::uint32_t length;
+};
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t trackCount;
+    StringRef name;
+    StringRef description;
+    std::uint64_t stringTableOffset;
+    std::uint64_t stringTableSize;
+    std::uint64_t recordsOffset;
+    std::uint64_t contentOffset;
+    std::uint64_t contentSize;
+};
+static_assert(sizeof(Header) == 72, "library header layout changed");
+
+struct TrackRecord
+{
+    StringRef path;
+    StringRef title;
+    StringRef artist;
+    StringRef codec;
+    std::int32_t durationMs;
+    std::uint32_t reserved;
+    std::uint64_t contentOffset; // in the content blob
+    std::uint64_t contentLength;
+};
+static_assert(sizeof(TrackRecord) == 56, "library track record layout changed");
+
+class StringTableBuilder
+{
+public:
+    StringRef add(std::string_view s)
+    {
+        auto it = m_offsets.find(std::string(s));
+        if (it != m_offsets.end())
+        {
+            return {it->second, static_cast<std::uint32_t>(s.size())};
+        }
+        auto offset = static_cast<std::uint32_t>(m_data.size());
+        m_data.append(s);
+        m_offsets.emplace(std::string(s), offset);
+        return {offset, static_cast<std::uint32_t>(s.size())};
+    }
+
+    const std::string& data() const
+    {
+        return m_data;
+    }
+
+private:
+    std::string m_data;
+    std::unordered_map<std::string, std::uint32_t> m_offsets;
+};
+
+template <typename T>
+void writePod(std::ofstream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// The mapping gives no alignment guarantee for the records, hence the copy
+template <typename T>
+T readPod(const char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool inBounds(std::uint64_t offset, std::uint64_t size, std::uint64_t limit)
+{
+    return offset <= limit && size <= limit - offset;
+}
+}
+
+namespace library
+{
+bool compile(const Playlist& playlist, const std::filesystem::path& path)
+{
+    StringTableBuilder strings;
+    std::vector<TrackRecord> records;
+    records.reserve(playlist.size());
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.trackCount = static_cast<std::uint32_t>(playlist.size());
+    header.name = strings.add(playlist.name());
+    header.description = strings.add(playlist.description());
+
+    std::uint64_t contentSize = 0;
+    for (const auto& track : playlist.tracks())
+    {
+        TrackRecord record{};
+        record.path = strings.add(track->path());
+        record.title = strings.add(track->title());
+        record.artist = strings.add(track->artist());
+        record.codec = strings.add(track->codec());
+        record.durationMs = track->duration();
+        record.contentOffset = contentSize;
+        record.contentLength = track->contentSize();
+        contentSize += record.contentLength;
+        records.push_back(record);
+    }
+
+    header.stringTableOffset = sizeof(Header);
+    header.stringTableSize = strings.data().size();
+    header.recordsOffset = header.stringTableOffset + header.stringTableSize;
+    header.contentOffset = header.recordsOffset + records.size() * sizeof(TrackRecord);
+    header.contentSize = contentSize;
+
+    // Written next to path and renamed over it: path may be the library the tracks are mapped from, which
+    // must not be truncated under them
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+    std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!os)
+    {
+        ERROR_LOG("Cannot open " << tmpPath << " for writing");
+        return false;
+    }
+
+    writePod(os, header);
+    os.write(strings.data().data(), strings.data().size());
+    for (const auto& record : records)
+    {
+        writePod(os, record);
+    }
+    bool changed = false;
+    for (std::size_t i = 0; i < records.size() && !changed; ++i)
+    {
+        // The content of a lazy track is read for the write only
+        const auto& track = playlist.tracks()[i];
+        bool wasLoaded = track->isContentLoaded();
+        {
+            auto pin = track->pinContent();
+            changed = pin.content.size() != records[i].contentLength;
+            os.write(pin.content.data(), pin.content.size());
+        }
+        if (!wasLoaded)
+        {
+            track->evictContent();
+        }
+    }
+    os.close();
+
+    std::error_code ec;
+    if (changed)
+    {
+        ERROR_LOG("Cannot compile " << path << ", a track file changed since the import");
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    if (!os)
+    {
+        ERROR_LOG("Failed to write library file " << tmpPath);
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    fs::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        ERROR_LOG("Cannot rename " << tmpPath << " to " << path << ": " << ec.message());
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Playlist> load(const std::filesystem::path& path, bool indexContent)
+{
+    auto mapping = MappedFile::open(path);
+    if (!mapping || mapping->size() < sizeof(Header))
+    {
+        ERROR_LOG("Cannot map library file " << path);
+        return nullptr;
+    }
+
+    auto header = readPod<Header>(mapping->data());
+    auto fileSize = mapping->size();
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+        || !inBounds(header.stringTableOffset, header.stringTableSize, fileSize)
+        || !inBounds(header.recordsOffset, std::uint64_t(header.trackCount) * sizeof(TrackRecord), fileSize)
+        || !inBounds(header.contentOffset, header.contentSize, fileSize))
+    {
+        ERROR_LOG("Invalid library file " << path << " (corrupted file or unsupported version)");
+        return nullptr;
+    }
+
+    std::string_view stringTable(mapping->data() + header.stringTableOffset, header.stringTableSize);
+    std::string_view content(mapping->data() + header.contentOffset, header.contentSize);
+    bool corrupted = false;
+    auto str = [&stringTable, &corrupted](StringRef ref)
+    {
+        if (!inBounds(ref.offset, ref.length, stringTable.size()))
+        {
+            corrupted = true;
+            return std::string_view();
+        }
+        return stringTable.substr(ref.offset, ref.length);
+    };
+
+    auto playlist = std::make_shared<Playlist>();
+    playlist->setName(std::string(str(header.name)));
+    playlist->setDescription(std::string(str(header.description)));
+
+    auto arena = playlist->arena();
+    const char* recordData = mapping->data() + header.recordsOffset;
+    for (std::uint32_t i = 0; i < header.trackCount && !corrupted; ++i)
+    {
+        auto record = readPod<TrackRecord>(recordData + i * sizeof(TrackRecord));
+        if (!inBounds(record.contentOffset, record.contentLength, content.size()))
+        {
+            corrupted = true;
+            break;
+        }
+
+        auto track = arena->newTrack();
+        track->initFromFields(str(record.path), str(record.title), str(record.artist), str(record.codec),
+                              record.durationMs, content.substr(record.contentOffset, record.contentLength),
+                              mapping);
+        playlist->addTrack(track, indexContent);
+    }
+
+    if (corrupted)
+    {
+        ERROR_LOG("Invalid library file " << path << " (corrupted file)");
+        return nullptr;
+    }
+
+    playlist->validate(true);
+    playlist->resetToFirstTrack();
+    return playlist;
+}
+
+bool isLibraryFile(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(Magic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+}
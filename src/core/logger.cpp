@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include "core/logger.hpp"
+#include "core/helper.hpp"
+
+namespace
+{
+    const char* levelName(LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::Trace:
+            return "trace";
+        case LogLevel::Debug:
+            return "debug";
+        case LogLevel::Info:
+            return "info";
+        case LogLevel::Warn:
+            return "warn";
+        case LogLevel::Error:
+            return "error";
+        default:
+            return "off";
+        }
+    }
+
+    // Append text as the content of a JSON string, without the ANSI escape sequences
+    void appendJsonString(std::string& out, std::string_view text)
+    {
+        for (std::size_t i = 0; i < text.size(); ++i)
+        {
+            char c = text[i];
+            if (c == '\x1B')
+            {
+                // CSI sequence: ESC '[' parameters final byte
+                if (i + 1 < text.size() && text[i + 1] == '[')
+                {
+                    i += 2;
+                    while (i < text.size() && (text[i] < '@' || text[i] > '~'))
+                    {
+                        i++;
+                    }
+                }
+                continue;
+            }
+
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                }
+                else
+                {
+                    out += c;
+                }
+                break;
+            }
+        }
+    }
+
+    unsigned threadNumber()
+    {
+        static std::atomic<unsigned> next{0};
+        thread_local unsigned number = next++;
+        return number;
+    }
+}
+
+Logger& Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : m_start(std::chrono::steady_clock::now())
+{
+    if (const char* level = std::getenv("IMPLAYER_LOG_LEVEL"))
+    {
+        auto name = helper::normalize(level);
+        for (auto candidate : {LogLevel::Trace, LogLevel::Debug, LogLevel::Info, LogLevel::Warn,
+                               LogLevel::Error, LogLevel::Off})
+        {
+            if (name == levelName(candidate))
+            {
+                m_level = candidate;
+            }
+        }
+    }
+    if (const char* format = std::getenv("IMPLAYER_LOG_FORMAT"))
+    {
+        if (helper::normalize(format) == "json")
+        {
+            m_format = LogFormat::JsonLines;
+        }
+    }
+}
+
+void Logger::setLevel(LogLevel level)
+{
+    m_level = level;
+}
+
+LogLevel Logger::level() const
+{
+    return m_level;
+}
+
+void Logger::setFormat(LogFormat format)
+{
+    m_format = format;
+}
+
+LogFormat Logger::format() const
+{
+    return m_format;
+}
+
+std::ostringstream& Logger::threadBuffer()
+{
+    thread_local std::ostringstream buffer;
+    return buffer;
+}
+
+void Logger::emit(LogLevel level, OutputStream stream, std::ostringstream& buffer)
+{
+    std::string record;
+    if (m_format.load(std::memory_order_relaxed) == LogFormat::JsonLines)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        record = "{\"ts_us\":";
+        record += std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        record += ",\"level\":\"";
+        record += levelName(level);
+        record += "\",\"thread\":";
+        record += std::to_string(threadNumber());
+        record += ",\"msg\":\"";
+        appendJsonString(record, buffer.str());
+        record += "\"}\n";
+        // stdout carries the streamed content, the records stay parseable on their own stream
+        stream = OutputStream::Err;
+    }
+    else
+    {
+        record = buffer.str();
+        record += '\n';
+    }
+
+    buffer.str(std::string());
+    buffer.clear();
+    OutputSink::instance().write(stream, std::move(record));
+}
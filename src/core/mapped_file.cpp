@@ -0,0 +1,129 @@
+#include <cstdint>
+#include "core/mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::filesystem::path& path)
+{
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size))
+    {
+        CloseHandle(handle);
+        return nullptr;
+    }
+    file->m_size = static_cast<std::size_t>(size.QuadPart);
+
+    if (file->m_size > 0)
+    {
+        // The mapping keeps a reference to the file, the handle is not needed anymore
+        file->m_mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (file->m_mapping)
+        {
+            file->m_data = static_cast<const char*>(MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+    CloseHandle(handle);
+
+    if (file->m_size > 0 && !file->m_data)
+    {
+        return nullptr;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    file->m_size = static_cast<std::size_t>(st.st_size);
+
+    if (file->m_size > 0)
+    {
+        void* addr = mmap(nullptr, file->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            file->m_data = static_cast<const char*>(addr);
+        }
+    }
+    // The mapping keeps a reference to the file, the descriptor is not needed anymore
+    ::close(fd);
+
+    if (file->m_size > 0 && !file->m_data)
+    {
+        return nullptr;
+    }
+#endif
+    return file;
+}
+
+void MappedFile::willNeed(std::string_view range)
+{
+#ifndef _WIN32
+    if (range.empty())
+    {
+        return;
+    }
+    static const auto pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto begin = reinterpret_cast<std::uintptr_t>(range.data()) & ~(pageSize - 1);
+    auto end = reinterpret_cast<std::uintptr_t>(range.data()) + range.size();
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#else
+    (void)range;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+    }
+#else
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+}
+
+const char* MappedFile::data() const
+{
+    return m_data;
+}
+
+std::size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+std::string_view MappedFile::view() const
+{
+    return std::string_view(m_data, m_size);
+}
@@ -0,0 +1,189 @@
+#include <cstdlib>
+#include "core/output_sink.hpp"
+#include "core/helper.hpp"
+
+OutputSink& OutputSink::instance()
+{
+    static OutputSink sink;
+    return sink;
+}
+
+OutputSink::OutputSink()
+    : m_writer([this] { writerLoop(); })
+{
+    if (const char* policy = std::getenv("IMPLAYER_OUTPUT_POLICY"))
+    {
+        auto name = helper::normalize(policy);
+        if (name == "block")
+        {
+            m_policy = BackpressurePolicy::Block;
+        }
+        else if (name == "overwrite")
+        {
+            m_policy = BackpressurePolicy::Overwrite;
+        }
+    }
+}
+
+OutputSink::~OutputSink()
+{
+    m_stopping = true;
+    m_wakeup.notify();
+    m_writer.join();
+}
+
+bool OutputSink::write(OutputStream stream, std::string text)
+{
+    return push(Message{stream, std::move(text)}, BackpressurePolicy::Block);
+}
+
+bool OutputSink::writeContent(std::string text)
+{
+    return push(Message{OutputStream::Out, std::move(text)}, m_policy.load(std::memory_order_relaxed));
+}
+
+bool OutputSink::push(Message message, BackpressurePolicy policy)
+{
+    while (!m_queue.tryPush(std::move(message)))
+    {
+        switch (policy)
+        {
+        case BackpressurePolicy::Drop:
+            m_dropped++;
+            return false;
+        case BackpressurePolicy::Overwrite:
+        {
+            Message oldest;
+            if (m_queue.tryPop(oldest))
+            {
+                m_dropped++;
+                m_done++;
+            }
+            break;
+        }
+        case BackpressurePolicy::Block:
+        default:
+            waitAndPush(message);
+            m_queued++;
+            return true;
+        }
+    }
+    m_queued++;
+    wakeWriter();
+    return true;
+}
+
+void OutputSink::waitAndPush(Message& message)
+{
+    std::unique_lock<decltype(m_spaceMutex)> lock(m_spaceMutex);
+    m_blockedProducers++;
+    // Pairs with the fence of the writer between popping and reading m_blockedProducers: either it
+    // sees this producer and notifies, or this tryPush() sees the room it made
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!m_queue.tryPush(std::move(message)))
+    {
+        wakeWriter();
+        m_spaceFreed.wait(lock);
+    }
+    m_blockedProducers--;
+    lock.unlock();
+    wakeWriter();
+}
+
+void OutputSink::flush()
+{
+    auto target = m_queued.load();
+    std::unique_lock<decltype(m_flushMutex)> lock(m_flushMutex);
+    m_flushed.wait(lock, [this, target] { return m_done.load() >= target; });
+}
+
+void OutputSink::setPolicy(BackpressurePolicy policy)
+{
+    m_policy = policy;
+}
+
+BackpressurePolicy OutputSink::policy() const
+{
+    return m_policy;
+}
+
+std::uint64_t OutputSink::droppedCount() const
+{
+    return m_dropped;
+}
+
+void OutputSink::wakeWriter()
+{
+    // Only pay for the notification when the writer thread went to sleep. The fence pairs with the one
+    // of the writer between setting m_writerIdle and checking the queue.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerIdle.exchange(false))
+    {
+        m_wakeup.notify();
+    }
+}
+
+void OutputSink::writeOut(OutputStream stream, std::string& buffer)
+{
+    if (!buffer.empty())
+    {
+        (stream == OutputStream::Err ? m_err : m_out).write(buffer);
+        buffer.clear();
+    }
+}
+
+void OutputSink::writerLoop()
+{
+    std::string buffer;
+    OutputStream bufferStream = OutputStream::Out;
+    Message message;
+    while (true)
+    {
+        // Coalesce consecutive messages for the same stream, keeping the order across streams
+        std::uint64_t count = 0;
+        while (buffer.size() < OutputSinkFlushBytes && m_queue.tryPop(message))
+        {
+            if (message.stream != bufferStream)
+            {
+                writeOut(bufferStream, buffer);
+                bufferStream = message.stream;
+            }
+            buffer += message.text;
+            count++;
+        }
+        if (count > 0)
+        {
+            // Room was made for the producers blocked on a full buffer
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_blockedProducers.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<decltype(m_spaceMutex)> lock(m_spaceMutex);
+                m_spaceFreed.notify_all();
+            }
+        }
+        writeOut(bufferStream, buffer);
+
+        if (count > 0)
+        {
+            m_done += count;
+            std::lock_guard<decltype(m_flushMutex)> lock(m_flushMutex);
+            m_flushed.notify_all();
+            continue;
+        }
+
+        // A producer seeing m_writerIdle set after this point wakes us up. Without the fence, the check of
+        // the queue could be ordered before the store and miss a message pushed meanwhile.
+        m_writerIdle = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_queue.empty())
+        {
+            m_writerIdle = false;
+            continue;
+        }
+        if (m_stopping)
+        {
+            break;
+        }
+        m_wakeup.wait();
+    }
+}
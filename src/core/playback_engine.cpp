@@ -0,0 +1,294 @@
+#include <algorithm>
+#include "core/playback_engine.hpp"
+#include "core/helper.hpp"
+
+struct PlaybackEngine::Session
+{
+    SessionId id{0};
+    Sink sink;
+
+    // Owned by the worker ticking the session
+    PlaybackOrder order;
+    TrackCursor cursor; // current track and position in it
+    bool playing{false};
+    Clock::time_point nextTick;
+    std::uint64_t bytesStreamed{0};
+
+    // Guarded by PlaybackEngine::m_mutex
+    std::vector<SessionCommand> pending;
+    std::uint64_t generation{0};
+    bool ticking{false};
+    bool closed{false};
+    SessionState state;
+};
+
+PlaybackEngine::PlaybackEngine(std::shared_ptr<const Playlist> library, unsigned numWorkers,
+                               Clock::duration delayBetweenTracks)
+    : m_library(std::move(library))
+    , m_delayBetweenTracks(delayBetweenTracks)
+{
+    if (numWorkers == 0)
+    {
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(numWorkers);
+    for (unsigned i = 0; i < numWorkers; ++i)
+    {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+PlaybackEngine::~PlaybackEngine()
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+SessionId PlaybackEngine::openSession(Sink sink, std::optional<unsigned> seed)
+{
+    auto session = std::make_shared<Session>();
+    session->sink = std::move(sink);
+    if (seed)
+    {
+        session->order.seed(*seed);
+    }
+    session->order.assign(m_library->size());
+    if (session->order.current() != PlaybackOrder::NoTrack)
+    {
+        session->cursor.reset(m_library->tracks()[session->order.current()]);
+    }
+    session->state.currentTrackIndex = session->order.current();
+
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    session->id = m_nextSessionId++;
+    m_sessions.emplace(session->id, session);
+    return session->id;
+}
+
+void PlaybackEngine::closeSession(SessionId id)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        return;
+    }
+    // Entries left in the schedule are dropped when they come due
+    it->second->closed = true;
+    m_sessions.erase(it);
+}
+
+bool PlaybackEngine::post(SessionId id, SessionCommand command)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        return false;
+    }
+
+    auto& session = it->second;
+    session->pending.push_back(command);
+    if (!session->ticking)
+    {
+        schedule(session, Clock::now());
+    }
+    // Otherwise the worker ticking the session reschedules it as soon as it is done
+    return true;
+}
+
+std::optional<SessionState> PlaybackEngine::sessionState(SessionId id) const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    auto it = m_sessions.find(id);
+    if (it == m_sessions.end())
+    {
+        return std::nullopt;
+    }
+    return it->second->state;
+}
+
+std::size_t PlaybackEngine::sessionCount() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_sessions.size();
+}
+
+void PlaybackEngine::schedule(const std::shared_ptr<Session>& session, Clock::time_point deadline)
+{
+    session->generation++;
+    bool earliest = m_schedule.empty() || deadline < m_schedule.top().deadline;
+    m_schedule.push({deadline, session->generation, session});
+    if (earliest)
+    {
+        m_cv.notify_one();
+    }
+}
+
+void PlaybackEngine::workerLoop()
+{
+    std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+    while (!m_stopping)
+    {
+        if (m_schedule.empty())
+        {
+            m_cv.wait(lock);
+            continue;
+        }
+
+        auto deadline = m_schedule.top().deadline;
+        if (deadline > Clock::now())
+        {
+            m_cv.wait_until(lock, deadline);
+            continue;
+        }
+
+        auto entry = m_schedule.top();
+        m_schedule.pop();
+        auto& session = *entry.session;
+        if (session.closed || entry.generation != session.generation)
+        {
+            continue;
+        }
+
+        // Due entries may be waiting for another worker
+        if (!m_schedule.empty() && m_schedule.top().deadline <= Clock::now())
+        {
+            m_cv.notify_one();
+        }
+
+        session.ticking = true;
+        std::vector<SessionCommand> commands;
+        commands.swap(session.pending);
+        lock.unlock();
+
+        auto next = tick(session, commands);
+
+        lock.lock();
+        session.ticking = false;
+        session.state.currentTrackIndex = session.order.current();
+        session.state.playing = session.playing;
+        session.state.shuffled = session.order.isShuffled();
+        session.state.repeatMode = session.order.repeatMode();
+        session.state.bytesStreamed = session.bytesStreamed;
+        if (session.closed)
+        {
+            continue;
+        }
+
+        if (!session.pending.empty())
+        {
+            // Commands posted during the tick
+            next = Clock::now();
+        }
+        if (next)
+        {
+            schedule(entry.session, *next);
+        }
+    }
+}
+
+std::optional<PlaybackEngine::Clock::time_point> PlaybackEngine::tick(Session& session,
+                                                                      const std::vector<SessionCommand>& commands)
+{
+    auto now = Clock::now();
+    for (auto command : commands)
+    {
+        applyCommand(session, command, now);
+    }
+
+    if (!session.playing || !session.cursor.track())
+    {
+        session.playing = false;
+        return std::nullopt;
+    }
+
+    if (now < session.nextTick)
+    {
+        // Woken up by a command which did not change the schedule
+        return session.nextTick;
+    }
+
+    if (!session.cursor.endOfTrack())
+    {
+        // Everything due since the last tick goes out as one chunk
+        auto interval = helper::contentInterval(*session.cursor.track());
+        auto chunk = session.cursor.takeFor(now - session.nextTick + interval);
+        session.sink(session.id, chunk);
+        session.bytesStreamed += chunk.size();
+
+        session.nextTick += interval * static_cast<Clock::rep>(chunk.size());
+        if (session.nextTick + interval < now)
+        {
+            session.nextTick = now;
+        }
+        return session.nextTick;
+    }
+
+    // End of the track
+    if (session.order.next(true /*autoplay*/) == PlaybackOrder::NoTrack)
+    {
+        session.playing = false;
+        return std::nullopt;
+    }
+    session.cursor.reset(m_library->tracks()[session.order.current()]);
+    session.nextTick = now + m_delayBetweenTracks;
+    return session.nextTick;
+}
+
+void PlaybackEngine::seekCurrent(Session& session, int trackIdx)
+{
+    session.cursor.reset(trackIdx == PlaybackOrder::NoTrack ? nullptr : m_library->tracks()[trackIdx]);
+}
+
+void PlaybackEngine::applyCommand(Session& session, SessionCommand command, Clock::time_point now)
+{
+    switch (command)
+    {
+    case SessionCommand::Play:
+        if (!session.playing)
+        {
+            if (session.order.current() == PlaybackOrder::NoTrack)
+            {
+                seekCurrent(session, session.order.reset());
+            }
+            session.playing = session.cursor.track() != nullptr;
+            session.nextTick = now;
+        }
+        break;
+    case SessionCommand::Pause:
+        session.playing = false;
+        break;
+    case SessionCommand::Next:
+        seekCurrent(session, session.order.next(false));
+        session.nextTick = now;
+        break;
+    case SessionCommand::Previous:
+        seekCurrent(session, session.order.previous());
+        session.nextTick = now;
+        break;
+    case SessionCommand::Shuffle:
+        if (session.order.isShuffled())
+        {
+            session.order.unshuffle();
+        }
+        else
+        {
+            session.order.shuffle();
+        }
+        break;
+    case SessionCommand::Repeat:
+        session.order.repeat();
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include "core/playback_order.hpp"
+
+int PlaybackOrder::size() const
+{
+    return m_size;
+}
+
+void PlaybackOrder::assign(int size)
+{
+    clear();
+    m_size = size;
+    m_currentPos = size > 0 ? 0 : NoTrack;
+    if (m_isShuffled)
+    {
+        // Still shuffled: the order must cover the new tracks
+        buildShuffledOrder();
+    }
+}
+
+void PlaybackOrder::append()
+{
+    int trackIdx = m_size++;
+    if (m_size == 1)
+    {
+        m_currentPos = 0;
+    }
+    if (m_shuffledOrder.empty() && !m_isShuffled)
+    {
+        // Not shuffled yet: the order is drawn on the first shuffle
+        return;
+    }
+
+    // Add the track at a random point of the shuffled order: the track at that point moves to the end
+    // (inside-out Fisher-Yates). While shuffled, only the upcoming tracks are candidates so that neither
+    // the current track nor an already played one is pushed back into the queue.
+    int first = (m_isShuffled && m_currentPos != NoTrack) ? m_currentPos + 1 : 0;
+    int insertPos = std::uniform_int_distribution<int>(first, trackIdx)(m_rng);
+    m_shuffledOrder.push_back(trackIdx);
+    m_shuffledPos.push_back(trackIdx);
+    if (insertPos != trackIdx)
+    {
+        int displaced = m_shuffledOrder[insertPos];
+        m_shuffledOrder[trackIdx] = displaced;
+        m_shuffledPos[displaced] = trackIdx;
+        m_shuffledOrder[insertPos] = trackIdx;
+        m_shuffledPos[trackIdx] = insertPos;
+    }
+}
+
+void PlaybackOrder::erase(const std::vector<bool>& removed)
+{
+    // Position of the current track once the removed tracks are gone. If the current track itself is
+    // removed, the next remaining one in the active order becomes current.
+    int newPos = NoTrack;
+    if (m_currentPos != NoTrack)
+    {
+        newPos = 0;
+        for (int pos = 0; pos < m_currentPos; ++pos)
+        {
+            if (!removed[trackIndexAt(pos)])
+            {
+                ++newPos;
+            }
+        }
+    }
+
+    std::vector<int> newIndex(m_size, NoTrack);
+    int kept = 0;
+    for (int i = 0; i < m_size; ++i)
+    {
+        if (!removed[i])
+        {
+            newIndex[i] = kept++;
+        }
+    }
+    m_size = kept;
+
+    if (!m_shuffledOrder.empty())
+    {
+        int keptInOrder = 0;
+        m_shuffledPos.resize(kept);
+        for (auto trackIdx : m_shuffledOrder)
+        {
+            if (newIndex[trackIdx] != NoTrack)
+            {
+                m_shuffledPos[newIndex[trackIdx]] = keptInOrder;
+                m_shuffledOrder[keptInOrder++] = newIndex[trackIdx];
+            }
+        }
+        m_shuffledOrder.resize(keptInOrder);
+    }
+
+    if (m_size == 0)
+    {
+        m_currentPos = NoTrack;
+    }
+    else if (newPos != NoTrack)
+    {
+        // Past the last track: go back to the first one
+        m_currentPos = newPos < m_size ? newPos : 0;
+    }
+}
+
+void PlaybackOrder::clear()
+{
+    m_size = 0;
+    m_shuffledOrder.clear();
+    m_shuffledPos.clear();
+    m_currentPos = NoTrack;
+}
+
+int PlaybackOrder::trackIndexAt(int pos) const
+{
+    return m_isShuffled ? m_shuffledOrder[pos] : pos;
+}
+
+int PlaybackOrder::positionOf(int trackIdx) const
+{
+    return m_isShuffled ? m_shuffledPos[trackIdx] : trackIdx;
+}
+
+int PlaybackOrder::current() const
+{
+    return m_currentPos == NoTrack ? NoTrack : trackIndexAt(m_currentPos);
+}
+
+int PlaybackOrder::reset()
+{
+    m_currentPos = m_size > 0 ? 0 : NoTrack;
+    return current();
+}
+
+int PlaybackOrder::seek(int trackIdx)
+{
+    if (trackIdx < 0 || trackIdx >= m_size)
+    {
+        return NoTrack;
+    }
+    m_currentPos = positionOf(trackIdx);
+    return current();
+}
+
+int PlaybackOrder::next(bool autoplay)
+{
+    if (m_size == 0 || m_currentPos == NoTrack)
+    {
+        m_currentPos = NoTrack;
+        return NoTrack;
+    }
+
+    if (m_repeatMode == RepeatMode::RepeatCurrentSong)
+    {
+        if (autoplay)
+        {
+            // Return the current song and do nothing else
+            return current();
+        }
+        else
+        {
+            m_repeatMode = RepeatMode::RepeatWholePlaylist;
+        }
+    }
+
+    ++m_currentPos;
+    if (m_currentPos == m_size)
+    {
+        if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
+        {
+            m_currentPos = 0;
+        }
+        else
+        {
+            m_currentPos = NoTrack;
+        }
+    }
+    return current();
+}
+
+int PlaybackOrder::peekNext() const
+{
+    if (m_size == 0 || m_currentPos == NoTrack)
+    {
+        return NoTrack;
+    }
+    if (m_repeatMode == RepeatMode::RepeatCurrentSong)
+    {
+        return current();
+    }
+    if (m_currentPos + 1 == m_size)
+    {
+        return m_repeatMode == RepeatMode::RepeatWholePlaylist ? trackIndexAt(0) : NoTrack;
+    }
+    return trackIndexAt(m_currentPos + 1);
+}
+
+int PlaybackOrder::distanceFromCurrent(int trackIdx) const
+{
+    if (m_currentPos == NoTrack || trackIdx < 0 || trackIdx >= m_size)
+    {
+        return m_size;
+    }
+    auto distance = std::abs(positionOf(trackIdx) - m_currentPos);
+    if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
+    {
+        distance = std::min(distance, m_size - distance);
+    }
+    return distance;
+}
+
+std::vector<int> PlaybackOrder::window(int radius) const
+{
+    std::vector<int> trackIndices;
+    if (m_currentPos == NoTrack)
+    {
+        return trackIndices;
+    }
+    int first = m_currentPos - radius;
+    int last = m_currentPos + radius;
+    if (m_repeatMode == RepeatMode::RepeatWholePlaylist && last - first + 1 < m_size)
+    {
+        // Wraps around
+        for (int pos = first; pos <= last; ++pos)
+        {
+            trackIndices.push_back(trackIndexAt((pos % m_size + m_size) % m_size));
+        }
+        return trackIndices;
+    }
+    for (int pos = std::max(first, 0); pos <= std::min(last, m_size - 1); ++pos)
+    {
+        trackIndices.push_back(trackIndexAt(pos));
+    }
+    return trackIndices;
+}
+
+int PlaybackOrder::previous()
+{
+    if (m_size == 0 || m_currentPos == NoTrack)
+    {
+        m_currentPos = NoTrack;
+        return NoTrack;
+    }
+
+    if (m_repeatMode == RepeatMode::RepeatCurrentSong)
+    {
+        // Return the current song and do nothing else
+        return current();
+    }
+
+    if (m_currentPos > 0)
+    {
+        --m_currentPos;
+    }
+    else if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
+    {
+        m_currentPos = m_size - 1;
+    }
+    else
+    {
+        m_currentPos = NoTrack;
+    }
+    return current();
+}
+
+bool PlaybackOrder::isShuffled() const
+{
+    return m_isShuffled;
+}
+
+void PlaybackOrder::seed(unsigned seed)
+{
+    m_rng.seed(seed);
+    if (!m_shuffledOrder.empty())
+    {
+        // Drawn with the previous seed
+        reshuffle();
+    }
+}
+
+void PlaybackOrder::shuffle()
+{
+    if (m_isShuffled)
+    {
+        return;
+    }
+
+    if (static_cast<int>(m_shuffledOrder.size()) != m_size)
+    {
+        buildShuffledOrder();
+    }
+
+    // Turning shuffle on only has to move the current track to the front
+    int currentIdx = current();
+    if (currentIdx != NoTrack)
+    {
+        swapShuffledPositions(0, m_shuffledPos[currentIdx]);
+    }
+    m_isShuffled = true;
+    m_currentPos = m_size == 0 ? NoTrack : 0;
+}
+
+void PlaybackOrder::reshuffle()
+{
+    if (!m_isShuffled)
+    {
+        // Used by the next shuffle()
+        buildShuffledOrder();
+        return;
+    }
+
+    int currentIdx = current();
+    buildShuffledOrder();
+    m_isShuffled = false;
+    if (currentIdx != NoTrack)
+    {
+        m_currentPos = currentIdx;
+    }
+    shuffle();
+}
+
+void PlaybackOrder::unshuffle()
+{
+    if (m_isShuffled && m_currentPos != NoTrack)
+    {
+        m_currentPos = m_shuffledOrder[m_currentPos];
+    }
+    m_isShuffled = false;
+}
+
+void PlaybackOrder::buildShuffledOrder()
+{
+    m_shuffledOrder.resize(m_size);
+    std::iota(m_shuffledOrder.begin(), m_shuffledOrder.end(), 0);
+    std::shuffle(m_shuffledOrder.begin(), m_shuffledOrder.end(), m_rng);
+    m_shuffledPos.resize(m_size);
+    for (int pos = 0; pos < m_size; ++pos)
+    {
+        m_shuffledPos[m_shuffledOrder[pos]] = pos;
+    }
+}
+
+void PlaybackOrder::swapShuffledPositions(int pos1, int pos2)
+{
+    std::swap(m_shuffledOrder[pos1], m_shuffledOrder[pos2]);
+    m_shuffledPos[m_shuffledOrder[pos1]] = pos1;
+    m_shuffledPos[m_shuffledOrder[pos2]] = pos2;
+}
+
+RepeatMode PlaybackOrder::repeatMode() const
+{
+    return m_repeatMode;
+}
+
+void PlaybackOrder::repeat()
+{
+    switch (m_repeatMode)
+    {
+    case RepeatMode::NoRepeat:
+        m_repeatMode = RepeatMode::RepeatWholePlaylist;
+        break;
+    case RepeatMode::RepeatWholePlaylist:
+        m_repeatMode = RepeatMode::RepeatCurrentSong;
+        break;
+    case RepeatMode::RepeatCurrentSong:
+        m_repeatMode = RepeatMode::NoRepeat;
+        break;
+    default:
+        break;
+    }
+}
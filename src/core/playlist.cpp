@@ -1,7 +1,36 @@
 #include "core/playlist.hpp"
 #include "core/logger.hpp"
+#include "core/constants.hpp"
+#include "core/thread_pool.hpp"
+#include <algorithm>
 #include <fstream>
-#include <set>
+#include <mutex>
+#include <unordered_set>
+
+namespace
+{
+// Same parsed fields. The lazy contents loaded for the comparison are evicted again.
+bool sameFields(const Track& a, const Track& b)
+{
+    if (a.titleHandle() != b.titleHandle() || a.artistHandle() != b.artistHandle() ||
+        a.codecHandle() != b.codecHandle() || a.duration() != b.duration() || a.contentSize() != b.contentSize())
+    {
+        return false;
+    }
+    bool aLoaded = a.isContentLoaded();
+    bool bLoaded = b.isContentLoaded();
+    bool same = a.pinContent().content == b.pinContent().content;
+    if (!aLoaded)
+    {
+        a.evictContent();
+    }
+    if (!bLoaded)
+    {
+        b.evictContent();
+    }
+    return same;
+}
+}
 
 void Playlist::setName(const std::string& name)
 {
@@ -28,24 +57,210 @@ const TrackList & Playlist::tracks() const
     return m_tracks;
 }
 
-int Playlist::importFromFolder(std::filesystem::path path)
+std::vector<fs::path> Playlist::listFolder(const fs::path& path)
 {
-    int count = 0;
-    for (const auto & entry : fs::directory_iterator(path))
+    std::vector<fs::path> paths;
+    std::error_code ec;
+    fs::directory_iterator it(path, ec);
+    if (ec)
     {
-        std::shared_ptr<Track> track = std::make_shared<Track>();
-        if (track->initFromFile(entry.path()))
+        ERROR_LOG("Cannot list the folder " << path << ": " << ec.message());
+        return paths;
+    }
+    for (; it != fs::directory_iterator(); it.increment(ec))
+    {
+        if (it->is_regular_file(ec))
         {
-            addTrack(track);
-            count++;
+            paths.push_back(it->path());
         }
     }
+    // The directory iteration order is unspecified
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
 
+int Playlist::importFromFolder(std::filesystem::path path, const ImportOptions& options)
+{
+    auto paths = listFolder(path);
+    auto ids = m_index.reserveIds(paths.size());
+    auto loaded = loadTracks(paths, ids, options);
+
+    m_folder = path;
+    m_journal.clear();
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        std::error_code ec;
+        JournalEntry entry;
+        entry.size = fs::file_size(paths[i], ec);
+        entry.mtime = fs::last_write_time(paths[i], ec);
+        entry.track = loaded[i];
+        m_journal[paths[i].string()] = std::move(entry);
+    }
+
+    int count = appendLoaded(paths, loaded, ids);
     resetToFirstTrack();
     return count;
 }
 
-int Playlist::importFromFile(std::filesystem::path path)
+FolderDiff Playlist::rescanFolder(const ImportOptions& options)
+{
+    FolderDiff diff;
+    if (!m_folder)
+    {
+        WARN_MSG("No folder imported, nothing to rescan");
+        return diff;
+    }
+
+    std::vector<fs::path> toLoad;
+    std::unordered_set<std::string> present;
+    // Changed files without a previous hash, parsed and compared with their track instead
+    std::unordered_set<std::string> unhashed;
+    for (auto& path : listFolder(*m_folder))
+    {
+        auto key = path.string();
+        auto it = m_journal.find(key);
+        std::error_code sizeEc;
+        std::error_code mtimeEc;
+        auto size = fs::file_size(path, sizeEc);
+        auto mtime = fs::last_write_time(path, mtimeEc);
+        if (sizeEc || mtimeEc)
+        {
+            // Listed but not readable right now (e.g. being replaced): a known file keeps its track and
+            // its entry, compared again by the next rescan, a new one is added by the next rescan
+            if (it != m_journal.end())
+            {
+                present.insert(key);
+            }
+            WARN_MSG("Cannot stat " << path << ", checked again by the next rescan");
+            continue;
+        }
+        present.insert(key);
+
+        if (it == m_journal.end())
+        {
+            m_journal[key] = JournalEntry{size, mtime, std::nullopt, nullptr};
+            diff.added.push_back(path);
+            toLoad.push_back(path);
+            continue;
+        }
+
+        auto& entry = it->second;
+        if (entry.size == size && entry.mtime == mtime)
+        {
+            continue;
+        }
+        // Only read the content of the files which look changed, a touched file is not parsed again. The
+        // import does not hash the files (a lazy import would read them all), so the first time the file
+        // is parsed again and compared with its track.
+        auto hash = helper::fileHash(path);
+        bool changed = !(hash && entry.hash && *hash == *entry.hash);
+        if (!entry.hash && entry.track)
+        {
+            unhashed.insert(key);
+        }
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.hash = hash;
+        if (changed)
+        {
+            diff.updated.push_back(path);
+            toLoad.push_back(path);
+        }
+    }
+
+    // Track indices of the journal entries
+    std::unordered_map<const Track*, int> indexOf;
+    for (int i = 0; i < size(); ++i)
+    {
+        indexOf.emplace(m_tracks[i].get(), i);
+    }
+    auto trackIndex = [&indexOf](const TrackPtr& track)
+    {
+        auto it = track ? indexOf.find(track.get()) : indexOf.end();
+        return it == indexOf.end() ? NoTrack : it->second;
+    };
+
+    std::vector<bool> removed(m_tracks.size(), false);
+    for (auto it = m_journal.begin(); it != m_journal.end();)
+    {
+        if (present.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+        diff.removed.push_back(it->first);
+        auto trackIdx = trackIndex(it->second.track);
+        if (trackIdx != NoTrack)
+        {
+            removed[trackIdx] = true;
+        }
+        it = m_journal.erase(it);
+    }
+    std::sort(diff.removed.begin(), diff.removed.end());
+
+    // Updated tracks are replaced in place, so they keep their position in the playback orders and
+    // their id in the index
+    std::vector<int> trackIndices;
+    std::vector<TrackIndex::Id> ids;
+    for (const auto& path : toLoad)
+    {
+        auto trackIdx = trackIndex(m_journal[path.string()].track);
+        trackIndices.push_back(trackIdx);
+        ids.push_back(trackIdx == NoTrack ? m_index.reserveIds(1).front() : m_trackIds[trackIdx]);
+    }
+    // Allocated one by one: the arena never frees, so the tracks replaced by every rescan would pile up
+    // in it
+    auto loadOptions = options;
+    loadOptions.useArena = false;
+    auto loaded = loadTracks(toLoad, ids, loadOptions);
+    std::vector<fs::path> addedPaths;
+    std::vector<TrackPtr> added;
+    std::vector<TrackIndex::Id> addedIds;
+    std::unordered_set<std::string> unchanged;
+    for (std::size_t i = 0; i < toLoad.size(); ++i)
+    {
+        auto key = toLoad[i].string();
+        auto& entry = m_journal[key];
+        auto trackIdx = trackIndices[i];
+        if (trackIdx != NoTrack && loaded[i] && unhashed.count(key) && sameFields(*m_tracks[trackIdx], *loaded[i]))
+        {
+            // Touched only: keep the track, its words were indexed again unchanged
+            unchanged.insert(key);
+            continue;
+        }
+        entry.track = loaded[i];
+        if (trackIdx == NoTrack)
+        {
+            addedPaths.push_back(toLoad[i]);
+            added.push_back(loaded[i]);
+            addedIds.push_back(ids[i]);
+        }
+        else if (loaded[i])
+        {
+            m_tracks[trackIdx] = loaded[i];
+        }
+        else
+        {
+            WARN_MSG("Failed to reload track " << toLoad[i]);
+            removed[trackIdx] = true;
+        }
+    }
+
+    if (std::find(removed.begin(), removed.end(), true) != removed.end())
+    {
+        eraseTracks(removed);
+    }
+    appendLoaded(addedPaths, added, addedIds);
+    diff.updated.erase(std::remove_if(diff.updated.begin(), diff.updated.end(),
+                                      [&unchanged](const fs::path& path) { return unchanged.count(path.string()); }),
+                       diff.updated.end());
+
+    DEBUG_LOG("Rescanned " << *m_folder << ": " << diff.added.size() << " added, " << diff.removed.size()
+              << " removed, " << diff.updated.size() << " updated");
+    return diff;
+}
+
+int Playlist::importFromFile(std::filesystem::path path, const ImportOptions& options)
 {
     std::error_code ec;
     if (!fs::exists(path, ec) || !fs::is_regular_file(path, ec))
@@ -78,20 +293,104 @@ int Playlist::importFromFile(std::filesystem::path path)
         return 0;
     }
 
-    int count = 0;
-    m_tracks.clear();
-    m_shuffledPlaylist.clear();
+    clear();
     auto parentPath = path.parent_path();
+    std::vector<fs::path> paths;
     for (std::string line; getline(in, line);)
     {
-        TrackPtr track = std::make_shared<Track>();
-        if (track->initFromFile(parentPath / fs::path(line)))
+        paths.push_back(parentPath / fs::path(line));
+    }
+
+    int count = addTracksFromFiles(paths, options);
+    m_isValid = true;
+    return count;
+}
+
+const std::vector<fs::path>& Playlist::importFailures() const
+{
+    return m_importFailures;
+}
+
+int Playlist::addTracksFromFiles(const std::vector<fs::path>& paths, const ImportOptions& options)
+{
+    auto ids = m_index.reserveIds(paths.size());
+    return appendLoaded(paths, loadTracks(paths, ids, options), ids);
+}
+
+std::vector<TrackPtr> Playlist::loadTracks(const std::vector<fs::path>& paths,
+                                           const std::vector<TrackIndex::Id>& ids, const ImportOptions& options)
+{
+    // Every file gets its own slot so that the playlist order does not depend on the scheduling
+    std::vector<TrackPtr> loaded(paths.size());
+    auto arena = options.useArena && !options.useCache ? this->arena() : nullptr;
+    // Each thread splits its tracks into words, only the insertion into the index is serialized
+    std::mutex indexMutex;
+    auto loadTrack = [this, &paths, &ids, &loaded, &options, &arena, &indexMutex](std::size_t i)
+    {
+        try
+        {
+            TrackPtr loadedTrack;
+            if (options.useCache)
+            {
+                loadedTrack = TrackCache::instance().load(paths[i], options.loadMode);
+            }
+            else
+            {
+                // Moved into the arena once parsed, a failed load takes no slot
+                Track track;
+                if (track.initFromFile(paths[i], options.loadMode, arena.get()))
+                {
+                    loadedTrack = arena ? arena->newTrack(std::move(track)) : std::make_shared<Track>(std::move(track));
+                }
+            }
+            if (loadedTrack)
+            {
+                auto words = TrackIndex::wordsOf(*loadedTrack, options.indexContent);
+                std::lock_guard<decltype(indexMutex)> lock(indexMutex);
+                m_index.replace(ids[i], words);
+                loaded[i] = std::move(loadedTrack);
+            }
+        }
+        catch (const std::exception&)
         {
-            addTrack(track);
+            // Malformed value (e.g. duration), reported as a failure below
+        }
+    };
+
+    if (options.numThreads == 1 || paths.size() <= 1)
+    {
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            loadTrack(i);
+        }
+    }
+    else
+    {
+        ThreadPool pool(options.numThreads);
+        pool.parallelFor(paths.size(), ImportBatchSize, loadTrack);
+    }
+    return loaded;
+}
+
+int Playlist::appendLoaded(const std::vector<fs::path>& paths, const std::vector<TrackPtr>& loaded,
+                           const std::vector<TrackIndex::Id>& ids)
+{
+    int count = 0;
+    m_importFailures.clear();
+    for (std::size_t i = 0; i < paths.size(); ++i)
+    {
+        if (loaded[i])
+        {
+            appendTrack(loaded[i], ids[i]);
             count++;
         }
+        else
+        {
+            WARN_MSG("Failed to load track " << paths[i]);
+            m_importFailures.push_back(paths[i]);
+        }
     }
-    m_isValid = true;
+    DEBUG_LOG("Imported " << count << " of " << paths.size() << " track file(s)");
     return count;
 }
 
@@ -119,352 +418,305 @@ bool Playlist::isValid() const
 
 int Playlist::size() const
 {
-    return m_tracks.size();
+    return static_cast<int>(m_tracks.size());
 }
 
-std::shared_ptr<Track> Playlist::resetToFirstTrack()
+TrackPtr Playlist::trackAt(int trackIdx) const
 {
-    if (m_tracks.empty())
-    {
-        return nullptr;
-    }
+    return trackIdx == NoTrack ? nullptr : m_tracks[trackIdx];
+}
 
-    if (m_isShuffled)
-    {
-        m_currentTrackIter = m_shuffledPlaylist.begin();
-    }
-    else
-    {
-        m_currentTrackIter = m_tracks.begin();
-    }
+TrackPtr Playlist::resetToFirstTrack()
+{
+    return trackAt(m_order.reset());
+}
 
-    return *m_currentTrackIter;
+TrackPtr Playlist::currentTrack()
+{
+    return trackAt(m_order.current());
 }
 
-std::shared_ptr<Track> Playlist::currentTrack()
+int Playlist::currentTrackIndex() const
 {
-    // if (m_tracks.empty())
-    // {
-    //     return nullptr;
-    // }
-    // else
-    // {
-    //     return *m_currentTrackIter;
-    // }
-    return m_currentTrack;
+    return m_order.current();
 }
 
-std::shared_ptr<Track> Playlist::nextTrack(bool autoplay)
+TrackPtr Playlist::seek(int trackIdx)
 {
-    if (m_tracks.empty())
-    {
-        m_currentTrack = nullptr;
-        return nullptr;
-    }
+    return trackAt(m_order.seek(trackIdx));
+}
+
+TrackPtr Playlist::nextTrack(bool autoplay)
+{
+    return trackAt(m_order.next(autoplay));
+}
 
-    if (m_repeatMode == RepeatMode::RepeatCurrentSong)
+TrackPtr Playlist::peekNextTrack() const
+{
+    return trackAt(m_order.peekNext());
+}
+
+TrackPtr Playlist::previousTrack()
+{
+    return trackAt(m_order.previous());
+}
+
+void Playlist::addTrack(TrackPtr track, bool indexContent)
+{
+    auto id = m_index.add(TrackIndex::wordsOf(*track, indexContent));
+    appendTrack(std::move(track), id);
+}
+
+void Playlist::appendTrack(TrackPtr track, TrackIndex::Id id)
+{
+    m_trackIds.push_back(id);
+    m_tracks.push_back(std::move(track));
+    m_order.append();
+}
+
+bool Playlist::addTrackFromFile(std::filesystem::path path, const ImportOptions& options)
+{
+    if (options.useCache)
     {
-        if (autoplay)
+        auto track = TrackCache::instance().load(path, options.loadMode);
+        if (!track)
         {
-            // Return the current song and do nothing else
-            return m_currentTrack;
-        }
-        else
-        {
-            m_repeatMode = RepeatMode::RepeatWholePlaylist;
+            return false;
         }
+        appendTrack(track, m_index.add(TrackIndex::wordsOf(*track, options.indexContent)));
+        return true;
     }
 
-    if (m_isShuffled)
+    auto arena = options.useArena ? this->arena() : nullptr;
+    Track loaded;
+    if (!loaded.initFromFile(path, options.loadMode, arena.get()))
     {
-        if (m_currentTrackIter == m_shuffledPlaylist.end())
-        {
-            return nullptr;
-        }
-        ++m_currentTrackIter;
-        if (m_currentTrackIter == m_shuffledPlaylist.end())
-        {
-            if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
-            {
-                m_currentTrackIter = m_shuffledPlaylist.begin();
-            }
-            else
-            {
-                m_currentTrack = nullptr;
-                return nullptr;
-            }
-            
-        }
+        return false;
     }
-    else
+    auto track = arena ? arena->newTrack(std::move(loaded)) : std::make_shared<Track>(std::move(loaded));
+    appendTrack(track, m_index.add(TrackIndex::wordsOf(*track, options.indexContent)));
+    return true;
+}
+
+bool Playlist::removeTrack(int trackIdx)
+{
+    if (trackIdx >= size() || trackIdx < 0)
+    {
+        return false;
+    }
+
+    std::vector<bool> removed(m_tracks.size(), false);
+    removed[trackIdx] = true;
+    eraseTracks(removed);
+    return true;
+}
+
+void Playlist::eraseTracks(const std::vector<bool>& removed)
+{
+    m_order.erase(removed);
+
+    std::vector<TrackIndex::Id> removedIds;
+    int kept = 0;
+    for (int i = 0; i < size(); ++i)
     {
-        if (m_currentTrackIter == m_tracks.end())
+        if (!removed[i])
         {
-            m_currentTrack = nullptr;
-            return nullptr;
+            m_trackIds[kept] = m_trackIds[i];
+            m_tracks[kept++] = std::move(m_tracks[i]);
         }
-
-        ++m_currentTrackIter;
-        if (m_currentTrackIter == m_tracks.end())
+        else
         {
-            if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
-            {
-                m_currentTrackIter = m_tracks.begin();
-            }
-            else
-            {
-                m_currentTrack = nullptr;
-                return nullptr;
-            }
+            removedIds.push_back(m_trackIds[i]);
         }
     }
-
-    m_currentTrack = *m_currentTrackIter;
-    return m_currentTrack;
+    m_tracks.resize(kept);
+    m_trackIds.resize(kept);
+    m_index.erase(removedIds);
 }
 
-std::shared_ptr<Track> Playlist::previousTrack()
+std::vector<int> Playlist::search(std::string_view query, std::size_t limit) const
 {
-    if (m_tracks.empty())
+    // The ids increase along m_tracks: a binary search gives the index of each match
+    std::vector<int> indices;
+    for (auto id : m_index.search(query, limit))
     {
-        m_currentTrack = nullptr;
-        return nullptr;
+        auto it = std::lower_bound(m_trackIds.begin(), m_trackIds.end(), id);
+        indices.push_back(static_cast<int>(it - m_trackIds.begin()));
     }
+    return indices;
+}
 
-    if (m_repeatMode == RepeatMode::RepeatCurrentSong)
+namespace
+{
+struct InternedPairHash
+{
+    std::size_t operator()(const std::pair<InternedString, InternedString>& p) const
     {
-        // Return the current song and do nothing else
-        return *m_currentTrackIter; 
+        auto h = std::hash<InternedString>()(p.first);
+        return h ^ (std::hash<InternedString>()(p.second) + 0x9e3779b9 + (h << 6) + (h >> 2));
     }
+};
+}
 
-    if (m_isShuffled)
+int Playlist::removeDuplicate(DuplicateKey key)
+{
+    // Flag every track whose key was already seen, then drop them all in one sweep
+    std::vector<bool> removed(m_tracks.size(), false);
+    int count = 0;
+    auto flagDuplicates = [this, &removed, &count](auto&& seen, auto&& keyOf)
     {
-        if (m_currentTrackIter != m_shuffledPlaylist.begin())
+        seen.reserve(m_tracks.size());
+        for (int i = 0; i < size(); ++i)
         {
-            --m_currentTrackIter;
-        }
-        else
-        {
-            if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
+            if (!seen.insert(keyOf(*m_tracks[i])).second)
             {
-                m_currentTrackIter = std::prev(m_shuffledPlaylist.end(), 1);
-            }
-            else
-            {
-                m_currentTrack = nullptr;
-                return nullptr;
+                removed[i] = true;
+                count++;
             }
         }
-    }
-    else 
+    };
+
+    switch (key)
     {
-        if (m_currentTrackIter != m_tracks.begin())
+    case DuplicateKey::TitleArtist:
+        // Interned handles of the normalized strings: hashing and comparing never touch the characters
+        flagDuplicates(std::unordered_set<std::pair<InternedString, InternedString>, InternedPairHash>{},
+                       [](const Track& track)
         {
-            --m_currentTrackIter;
-        }
-        else
+            return std::make_pair(track.titleHandle().folded(), track.artistHandle().folded());
+        });
+        break;
+    case DuplicateKey::Content:
+    {
+        // Views stay valid as long as the tracks, no need to copy the contents. The lazy contents loaded
+        // for the comparison only are evicted afterwards, evictContent() does not scan the playlist.
+        std::vector<int> unloaded;
+        for (int i = 0; i < size(); ++i)
         {
-            if (m_repeatMode == RepeatMode::RepeatWholePlaylist)
+            if (!m_tracks[i]->isContentLoaded())
             {
-                m_currentTrackIter = std::prev(m_tracks.end(), 1);
+                unloaded.push_back(i);
             }
-            else
+        }
+        flagDuplicates(std::unordered_set<std::string_view>{}, [](const Track& track)
+        {
+            return track.content();
+        });
+        for (auto i : unloaded)
+        {
+            if (std::find(m_windowTracks.begin(), m_windowTracks.end(), m_tracks[i]) == m_windowTracks.end())
             {
-                m_currentTrack = nullptr;
-                return nullptr;
+                m_tracks[i]->evictContent();
             }
         }
+        break;
     }
-    m_currentTrack = *m_currentTrackIter;
-    return m_currentTrack;
-}
-
-void Playlist::addTrack(std::shared_ptr<Track> track)
-{
-    // Add the track at the end of the normal list
-    m_tracks.push_back(track);
-
-    // Add the track at a random point from the list
-    if (m_shuffledPlaylist.empty())
-    {
-        m_shuffledPlaylist.push_back(track);
-    }
-    else
-    {
-        auto randomPos = helper::randomInt(0, m_shuffledPlaylist.size());
-        auto iter = std::next(m_shuffledPlaylist.begin(), randomPos);
-        m_shuffledPlaylist.insert(iter, track);
+    case DuplicateKey::Path:
+        flagDuplicates(std::unordered_set<std::string>{}, [](const Track& track)
+        {
+            return track.path();
+        });
+        break;
+    default:
+        break;
     }
 
-    if (m_tracks.size() == 1)
+    if (count > 0)
     {
-        if (m_isShuffled)
-        {
-            m_currentTrackIter = m_shuffledPlaylist.begin();
-        }
-        else
-        {
-            m_currentTrackIter = m_tracks.begin();
-        }
-        m_currentTrack = *m_currentTrackIter;
+        eraseTracks(removed);
     }
+    return count;
 }
 
-bool Playlist::removeTrack(int trackIdx)
+bool Playlist::isShuffled() const
 {
-    if (trackIdx > m_tracks.size() || trackIdx < 0)
-    {
-        return false;
-    }
-    auto iter = std::next(m_tracks.begin(), trackIdx);
-    auto trackToRemove = *iter;
-    if (iter == m_currentTrackIter)
-    {
-        m_currentTrackIter = m_tracks.erase(iter);
-        iter = m_currentTrackIter;
-    }
-    else
-    {
-        iter = m_tracks.erase(iter);
-    }
-    
-    if (!m_tracks.empty() && !m_isShuffled && iter == m_tracks.end())
-    {
-        m_currentTrackIter = m_tracks.begin();
-    }
+    return m_order.isShuffled();
+}
 
-    for (auto iter2 = m_shuffledPlaylist.begin(); iter2 != m_shuffledPlaylist.end(); ++iter2)
-    {
-        if (*iter2 == trackToRemove)
-        {
-            m_shuffledPlaylist.erase(iter2);
+void Playlist::seed(unsigned seed)
+{
+    m_order.seed(seed);
+}
 
-            if (!m_shuffledPlaylist.empty() && m_isShuffled && iter2 == m_shuffledPlaylist.end())
-            {
-                m_currentTrackIter = m_shuffledPlaylist.begin();
-            }
-            break;
-        }
-    }
-    return true;    
+void Playlist::shuffle()
+{
+    m_order.shuffle();
 }
 
-struct TrackPtrComp
+void Playlist::reshuffle()
 {
-    bool operator()(const TrackPtr& lhs, const TrackPtr& rhs) const { 
-        return (lhs->title() < rhs->title()) && (lhs->artist() < rhs->artist()); 
-    }
-};
+    m_order.reshuffle();
+}
 
-void Playlist::removeDuplicate()
+void Playlist::unshuffle()
 {
-    std::set<TrackPtr, TrackPtrComp> found;
-    for (auto iter = m_tracks.begin(); iter != m_tracks.end(); )
-    {
-        if (!found.insert(*iter).second)
-        {
-            iter = m_tracks.erase(iter);
-            for (auto iter2 = m_shuffledPlaylist.begin(); m_isShuffled && iter2 != m_shuffledPlaylist.end(); ++iter2)
-            {
-                if (*iter2 == *iter)
-                {
-                    m_shuffledPlaylist.erase(iter2);
+    m_order.unshuffle();
+}
 
-                    if (!m_shuffledPlaylist.empty() && m_isShuffled && iter2 == m_shuffledPlaylist.end())
-                    {
-                        m_currentTrackIter = m_shuffledPlaylist.begin();
-                    }
-                    break;
-                }
-            }
-        }
-        else
-        {
-            ++iter;
-        }      
-    }
+RepeatMode Playlist::getRepeatMode() const
+{
+    return m_order.repeatMode();
 }
 
-bool Playlist::isShuffled() const
+const PlaybackOrder& Playlist::order() const
 {
-    return m_isShuffled;
+    return m_order;
 }
 
-void Playlist::shuffle()
+void Playlist::setContentWindow(int window)
 {
-    if (m_tracks.size() == 0)
-    {
-        m_shuffledPlaylist = std::list<TrackPtr>{};
-        return;
-    }
+    m_contentWindow = std::max(window, 0);
+}
 
-    std::vector<std::reference_wrapper<const TrackPtr>> v(m_tracks.begin(), m_tracks.end());
-    std::shuffle(v.begin(), v.end(), std::mt19937{ std::random_device{}()});
-    TrackList shuffled;
-    for (auto &ref : v) 
-    {
-        if (ref.get() == *m_currentTrackIter)
-        {
-            shuffled.push_front(std::move(ref.get()));
-        }
-        else
-        {
-            shuffled.push_back(std::move(ref.get()));
-        }
-    }
-    
-    m_shuffledPlaylist.swap(shuffled);
-    m_isShuffled = true;
-    m_currentTrackIter = m_shuffledPlaylist.begin();
+int Playlist::contentWindow() const
+{
+    return m_contentWindow;
 }
 
-void Playlist::unshuffle()
+int Playlist::evictContent()
 {
-    m_isShuffled = false;
-    if (m_currentTrackIter == m_shuffledPlaylist.end())
+    TrackList window;
+    for (auto trackIdx : m_order.window(m_contentWindow))
     {
-        m_currentTrackIter = m_tracks.begin();
-        m_shuffledPlaylist.clear();
-        return;
+        window.push_back(m_tracks[trackIdx]);
     }
 
-    for (auto it = m_tracks.begin(); it != m_tracks.end(); ++it)
+    // A few tracks on each side: linear searches beat any set
+    int count = 0;
+    for (const auto& track : m_windowTracks)
     {
-        if (*m_currentTrackIter == *it)
+        if (std::find(window.begin(), window.end(), track) == window.end() && track->evictContent())
         {
-            m_currentTrackIter = it;
-            break;
+            count++;
         }
     }
-    m_shuffledPlaylist.clear();
-}
-
-RepeatMode Playlist::getRepeatMode() const
-{
-    return m_repeatMode;
+    m_windowTracks = std::move(window);
+    return count;
 }
 
 void Playlist::repeat()
 {
-    switch (m_repeatMode)
-    {
-    case RepeatMode::NoRepeat:
-        m_repeatMode = RepeatMode::RepeatWholePlaylist;
-        break;
-    case RepeatMode::RepeatWholePlaylist:
-        m_repeatMode = RepeatMode::RepeatCurrentSong;
-        break;
-    case RepeatMode::RepeatCurrentSong:
-        m_repeatMode = RepeatMode::NoRepeat;
-        break;
-    default:
-        break;
-    }
-    
+    m_order.repeat();
 }
 
 void Playlist::clear()
 {
     m_tracks.clear();
-    m_shuffledPlaylist.clear();
+    m_trackIds.clear();
+    m_index.clear();
+    m_order.clear();
+    m_windowTracks.clear();
+    m_folder.reset();
+    m_journal.clear();
+    // Released with the last track still shared with another playlist
+    m_arena.reset();
+}
+
+std::shared_ptr<TrackArena> Playlist::arena()
+{
+    if (!m_arena)
+    {
+        m_arena = TrackArena::create();
+    }
+    return m_arena;
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <vector>
+#include "core/renderer.hpp"
+#include "core/constants.hpp"
+
+namespace render
+{
+    double Stats::megabytesPerSecond() const
+    {
+        auto seconds = std::chrono::duration<double>(elapsed).count();
+        return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+    }
+
+    Stats renderPlaylist(const Playlist& playlist, ContentWriter& writer, const Options& options)
+    {
+        static constexpr std::string_view separator{"\n"};
+
+        Stats stats;
+        auto start = std::chrono::steady_clock::now();
+        auto bytesBefore = writer.bytesWritten();
+
+        // Walk a copy of the order, the player keeps its position
+        auto order = playlist.order();
+        std::size_t maxTracks = playlist.tracks().size();
+        if (order.repeatMode() == RepeatMode::RepeatWholePlaylist)
+        {
+            maxTracks *= options.repeatCount;
+        }
+        else if (order.repeatMode() == RepeatMode::RepeatCurrentSong)
+        {
+            // The first track, repeatCount times
+            maxTracks = std::min<std::size_t>(maxTracks, 1) * options.repeatCount;
+        }
+
+        std::vector<std::string_view> batch;
+        batch.reserve(RenderBatchSize);
+        std::vector<ContentPin> pins; // the content of lazy tracks stays loaded until written
+        pins.reserve(RenderBatchSize);
+        // Lazy tracks loaded for the batch only, evicted once it is written
+        std::vector<const Track*> loadedTracks;
+        auto evictLoaded = [&loadedTracks]
+        {
+            for (auto* track : loadedTracks)
+            {
+                track->evictContent();
+            }
+            loadedTracks.clear();
+        };
+        for (int trackIdx = order.reset(); trackIdx != PlaybackOrder::NoTrack && stats.tracks < maxTracks;
+             trackIdx = order.next(true /*autoplay*/))
+        {
+            const auto& track = playlist.tracks()[trackIdx];
+            if (!track->isContentLoaded())
+            {
+                loadedTracks.push_back(track.get());
+            }
+            pins.push_back(track->pinContent());
+            batch.push_back(pins.back().content);
+            batch.push_back(separator);
+            stats.tracks++;
+            if (batch.size() + 2 > RenderBatchSize)
+            {
+                stats.ok = writer.write(batch.data(), batch.size());
+                batch.clear();
+                pins.clear();
+                evictLoaded();
+                if (!stats.ok)
+                {
+                    break;
+                }
+            }
+        }
+        if (stats.ok && !batch.empty())
+        {
+            stats.ok = writer.write(batch.data(), batch.size());
+        }
+        pins.clear();
+        evictLoaded();
+
+        stats.bytes = writer.bytesWritten() - bytesBefore;
+        stats.elapsed = std::chrono::steady_clock::now() - start;
+        return stats;
+    }
+}
@@ -0,0 +1,79 @@
+#include <mutex>
+#include "core/string_pool.hpp"
+#include "core/helper.hpp"
+
+struct StringPoolEntry
+{
+    std::string text;
+    const StringPoolEntry* folded{nullptr};
+};
+
+std::string_view InternedString::view() const
+{
+    return m_entry ? std::string_view(m_entry->text) : std::string_view();
+}
+
+InternedString InternedString::folded() const
+{
+    return InternedString(m_entry ? m_entry->folded : nullptr);
+}
+
+bool InternedString::empty() const
+{
+    return m_entry == nullptr;
+}
+
+StringPool& StringPool::instance()
+{
+    static StringPool pool;
+    return pool;
+}
+
+InternedString StringPool::intern(std::string_view s)
+{
+    if (s.empty())
+    {
+        return InternedString();
+    }
+
+    {
+        std::shared_lock<decltype(m_mutex)> lock(m_mutex);
+        auto it = m_index.find(s);
+        if (it != m_index.end())
+        {
+            return InternedString(it->second);
+        }
+    }
+
+    std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+    return InternedString(internLocked(s));
+}
+
+const StringPoolEntry* StringPool::internLocked(std::string_view s)
+{
+    if (s.empty())
+    {
+        return nullptr;
+    }
+
+    // Another thread may have added it between the shared and the exclusive lock
+    auto it = m_index.find(s);
+    if (it != m_index.end())
+    {
+        return it->second;
+    }
+
+    auto& entry = m_entries.emplace_back();
+    entry.text = std::string(s);
+    m_index.emplace(entry.text, &entry);
+
+    auto normalized = helper::normalize(entry.text);
+    entry.folded = normalized == entry.text ? &entry : internLocked(normalized);
+    return &entry;
+}
+
+std::size_t StringPool::size() const
+{
+    std::shared_lock<decltype(m_mutex)> lock(m_mutex);
+    return m_entries.size();
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <atomic>
+#include "core/thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(numThreads);
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_taskAvailable.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::size() const
+{
+    return static_cast<unsigned>(m_workers.size());
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_tasks.empty() && m_busyWorkers == 0; });
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t batchSize, const std::function<void(std::size_t)>& fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    batchSize = std::max<std::size_t>(1, batchSize);
+    std::atomic<std::size_t> nextIndex{0};
+    auto numBatches = (count + batchSize - 1) / batchSize;
+    auto numTasks = std::min<std::size_t>(m_workers.size(), numBatches);
+    for (std::size_t t = 0; t < numTasks; ++t)
+    {
+        submit([&nextIndex, count, batchSize, &fn]
+        {
+            for (auto begin = nextIndex.fetch_add(batchSize); begin < count; begin = nextIndex.fetch_add(batchSize))
+            {
+                auto end = std::min(begin + batchSize, count);
+                for (auto i = begin; i < end; ++i)
+                {
+                    fn(i);
+                }
+            }
+        });
+    }
+    wait();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+            m_taskAvailable.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+            m_busyWorkers++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+            m_busyWorkers--;
+            if (m_tasks.empty() && m_busyWorkers == 0)
+            {
+                m_idle.notify_all();
+            }
+        }
+    }
+}
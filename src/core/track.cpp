@@ -1,24 +1,41 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <fstream>
 #include "core/track.hpp"
+#include "core/constants.hpp"
+#include "core/mapped_file.hpp"
+#include "core/track_arena.hpp"
+#include "core/logger.hpp"
 
 namespace fs = std::filesystem;
-bool Track::parseKeyValue(const std::string& key, const std::string& val)
+InternedString Track::defaultArtist()
+{
+    static const InternedString unknown = StringPool::instance().intern("unknown");
+    return unknown;
+}
+
+bool Track::parseKeyValue(std::string_view key, std::string_view val)
 {
     if (key == "title")
     {
-        m_title = val;
+        m_title = StringPool::instance().intern(val);
     }
     else if (key == "artist")
     {
-        m_artist = val;
+        m_artist = StringPool::instance().intern(val);
     }
     else if (key == "codec")
     {
-        m_codec = val;
+        m_codec = StringPool::instance().intern(val);
     }
     else if (key == "duration")
     {
-        m_durationMs = std::stoi(val);
+        auto result = std::from_chars(val.data(), val.data() + val.size(), m_durationMs);
+        if (result.ec != std::errc())
+        {
+            return false;
+        }
     }
     else if (key == "content")
     {
@@ -32,21 +49,202 @@ bool Track::parseKeyValue(const std::string& key, const std::string& val)
     return true;
 }
 
-bool Track::initFromFile(std::filesystem::path path)
+bool Track::parse(std::string_view text)
 {
-    std::ifstream in(path);
-    std::string key, val;
-    
-    for (std::string line; getline(in, line);)
+    while (!text.empty())
     {
+        auto eol = text.find('\n');
+        auto line = text.substr(0, eol);
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+
         auto pos = line.find(' ');
-        key = line.substr(0, pos);
-        val = line.substr(pos+1, line.size()-pos-1);
+        auto key = line.substr(0, pos);
+        auto val = pos == std::string_view::npos ? std::string_view() : line.substr(pos + 1);
         if (!parseKeyValue(key, val))
         {
             return false;
         }
     }
+    return true;
+}
+
+std::optional<bool> Track::initLazy(const std::filesystem::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    std::error_code ec;
+    auto fileSize = fs::file_size(path, ec);
+    if (ec)
+    {
+        return std::nullopt;
+    }
+
+    // Read blocks until the line of the content key, parsing the complete lines before it
+    static constexpr std::string_view contentKey{"content "};
+    constexpr std::size_t blockSize = 4096;
+    std::string head;
+    std::size_t lineStart = 0;
+    std::optional<std::size_t> contentStart;
+    while (!contentStart)
+    {
+        auto eol = head.find('\n', lineStart);
+        std::string_view line(head.data() + lineStart, (eol == std::string::npos ? head.size() : eol) - lineStart);
+        if (line.substr(0, contentKey.size()) == contentKey)
+        {
+            contentStart = lineStart + contentKey.size();
+            break;
+        }
+
+        if (eol == std::string::npos)
+        {
+            if (in.eof())
+            {
+                // No content, the file is read entirely anyway
+                return parse(std::string_view(head).substr(lineStart));
+            }
+            auto size = head.size();
+            head.resize(size + blockSize);
+            in.read(head.data() + size, blockSize);
+            head.resize(size + in.gcount());
+            continue;
+        }
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line == "content")
+        {
+            contentStart = lineStart + line.size();
+            break;
+        }
+        if (!parse(line))
+        {
+            return false;
+        }
+        lineStart = eol + 1;
+    }
+
+    // The content line must be the last one: only check the end of the file, without reading the content
+    auto tailStart = std::max<std::uint64_t>(*contentStart, fileSize > blockSize ? fileSize - blockSize : 0);
+    std::string tail(fileSize - tailStart, '\0');
+    in.clear();
+    in.seekg(tailStart);
+    in.read(tail.data(), tail.size());
+    tail.resize(in.gcount());
+
+    auto end = tail.find_last_not_of("\r\n");
+    end = end == std::string::npos ? 0 : end + 1;
+    if (tail.find('\n') < end)
+    {
+        // Other keys after the content
+        return std::nullopt;
+    }
+
+    m_isLazy = true;
+    m_lazyOffset = *contentStart;
+    m_lazySize = tailStart + end - *contentStart;
+    return true;
+}
+
+bool Track::initFromFile(std::filesystem::path path, TrackLoadMode mode, TrackArena* arena)
+{
+    if (mode == TrackLoadMode::Lazy)
+    {
+        auto result = initLazy(path);
+        if (!result)
+        {
+            return initFromFile(path, TrackLoadMode::Copy, arena);
+        }
+        if (!*result)
+        {
+            return false;
+        }
+        m_path = path.is_relative() ? fs::current_path() / path : path;
+        return true;
+    }
+
+    std::shared_ptr<const MappedFile> mapping;
+    if (mode == TrackLoadMode::MemoryMapped)
+    {
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        mode = !ec && size >= MinMappedFileSize ? mode : TrackLoadMode::Copy;
+    }
+    if (mode == TrackLoadMode::MemoryMapped)
+    {
+        mapping = MappedFile::open(path);
+        static std::atomic<bool> warned{false};
+        if (!mapping && !warned.exchange(true))
+        {
+            // Once: an import over the mapping limit would warn for every file past it
+            WARN_MSG("Cannot map " << path << ", reading the track files that cannot be mapped instead"
+                                   << " (too many mappings? see vm.max_map_count)");
+        }
+    }
+
+    std::string_view text;
+    char* arenaData = nullptr;
+    std::size_t arenaSize = 0;
+    if (mapping)
+    {
+        text = mapping->view();
+        m_buffer = mapping;
+    }
+    else
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        if (arena && !ec)
+        {
+            arenaData = arena->allocate(size);
+            arenaSize = size;
+            in.read(arenaData, size);
+            text = std::string_view(arenaData, in.gcount());
+        }
+        else
+        {
+            auto buffer = std::make_shared<std::string>();
+            if (!ec)
+            {
+                buffer->resize(size);
+                in.read(buffer->data(), buffer->size());
+                buffer->resize(in.gcount());
+            }
+            else
+            {
+                buffer->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            text = *buffer;
+            m_buffer = std::move(buffer);
+        }
+    }
+
+    if (!parse(text))
+    {
+        if (arenaData)
+        {
+            arena->deallocate(arenaData, arenaSize);
+        }
+        return false;
+    }
     
     if (path.is_relative())
     {
@@ -59,23 +257,80 @@ bool Track::initFromFile(std::filesystem::path path)
     return true;
 }
 
+void Track::initFromFields(std::string_view path, std::string_view title, std::string_view artist,
+                           std::string_view codec, int durationMs, std::string_view content,
+                           std::shared_ptr<const void> buffer)
+{
+    m_path = fs::path(path);
+    m_title = StringPool::instance().intern(title);
+    m_artist = StringPool::instance().intern(artist);
+    m_codec = StringPool::instance().intern(codec);
+    m_durationMs = durationMs;
+    m_content = content;
+    m_buffer = std::move(buffer);
+    m_isLazy = false;
+}
+
+std::string_view Track::ownCopy(std::string_view value)
+{
+    auto copy = std::make_shared<const std::string>(value);
+    m_editedFields.push_back(copy);
+    return *copy;
+}
+
+void Track::setTitle(std::string_view title)
+{
+    m_title = StringPool::instance().intern(title);
+}
+
+void Track::setArtist(std::string_view artist)
+{
+    m_artist = StringPool::instance().intern(artist);
+}
+
+void Track::setCodec(std::string_view codec)
+{
+    m_codec = StringPool::instance().intern(codec);
+}
+
+void Track::setContent(std::string_view content)
+{
+    m_content = ownCopy(content);
+    m_isLazy = false;
+}
+
 // Getters
 std::string Track::path() const
 {
     return m_path.string();
 }
 
-const std::string& Track::title() const
+std::string_view Track::title() const
+{
+    return m_title.view();
+}
+
+std::string_view Track::artist() const
+{
+    return m_artist.view();
+}
+
+std::string_view Track::codec() const
+{
+    return m_codec.view();
+}
+
+InternedString Track::titleHandle() const
 {
     return m_title;
 }
 
-const std::string& Track::artist() const
+InternedString Track::artistHandle() const
 {
     return m_artist;
 }
 
-const std::string& Track::codec() const
+InternedString Track::codecHandle() const
 {
     return m_codec;
 }
@@ -85,36 +340,69 @@ int Track::duration() const
     return m_durationMs;
 }
 
-const std::string& Track::content() const
+std::string_view Track::content() const
 {
-    return m_content;
+    return pinContent().content;
 }
 
-char Track::streamCurrentContent()
+ContentPin Track::pinContent() const
 {
-    if (m_currentContentIndex < m_content.size())
+    if (!m_isLazy)
     {
-        auto c = m_content.at(m_currentContentIndex);
-        m_currentContentIndex++;
-        if (m_currentContentIndex == m_content.size())
-        {
-            m_endOfTrack = true;
-        }
-        return c;
+        return {nullptr, m_content};
     }
-    else
+
+    auto loaded = std::atomic_load(&m_lazyContent);
+    if (!loaded)
     {
-        return 0;
+        auto text = std::make_shared<std::string>(m_lazySize, '\0');
+        std::ifstream in(m_path, std::ios::binary);
+        in.seekg(m_lazyOffset);
+        in.read(text->data(), text->size());
+        if (static_cast<std::size_t>(in.gcount()) != text->size())
+        {
+            WARN_MSG("Failed to load the content of " << m_path << ", the file changed since the import");
+            text->resize(in.gcount());
+        }
+
+        // Another thread may have loaded it meanwhile, keep the first one
+        loaded = std::move(text);
+        std::shared_ptr<const std::string> expected;
+        if (!std::atomic_compare_exchange_strong(&m_lazyContent, &expected, loaded))
+        {
+            loaded = std::move(expected);
+        }
     }
+    std::string_view content = *loaded;
+    return {std::move(loaded), content};
+}
+
+std::size_t Track::contentSize() const
+{
+    return m_isLazy ? m_lazySize : m_content.size();
 }
 
-void Track::resetCurrentContentIndex()
+bool Track::evictContent() const
 {
-    m_currentContentIndex = 0;
-    m_endOfTrack = false;
+    return m_isLazy && std::atomic_exchange(&m_lazyContent, std::shared_ptr<const std::string>()) != nullptr;
 }
 
-bool Track::endOfTrack() const
+bool Track::isContentLoaded() const
 {
-    return m_endOfTrack;
-}
\ No newline at end of file
+    return !m_isLazy || std::atomic_load(&m_lazyContent) != nullptr;
+}
+
+void Track::prefetch() const
+{
+    auto pin = pinContent();
+    MappedFile::willNeed(pin.content);
+
+    // Touch one byte per page, the advice alone is not guaranteed to read anything
+    constexpr std::size_t pageSize = 4096;
+    volatile char sink = 0;
+    for (std::size_t i = 0; i < pin.content.size(); i += pageSize)
+    {
+        sink = pin.content[i];
+    }
+    (void)sink;
+}
@@ -0,0 +1,92 @@
+#include <new>
+#include "core/track_arena.hpp"
+
+std::shared_ptr<TrackArena> TrackArena::create()
+{
+    return std::shared_ptr<TrackArena>(new TrackArena());
+}
+
+TrackArena::~TrackArena()
+{
+    for (std::size_t i = 0; i < m_trackCount; ++i)
+    {
+        auto& slot = m_trackSlabs[i / TracksPerSlab][i % TracksPerSlab];
+        std::launder(reinterpret_cast<Track*>(&slot))->~Track();
+    }
+}
+
+std::shared_ptr<Track> TrackArena::newTrack()
+{
+    return newTrack(Track());
+}
+
+std::shared_ptr<Track> TrackArena::newTrack(Track&& loaded)
+{
+    Track* track = nullptr;
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        if (m_trackCount % TracksPerSlab == 0)
+        {
+            m_trackSlabs.emplace_back(new TrackStorage[TracksPerSlab]);
+        }
+        auto& slot = m_trackSlabs.back()[m_trackCount % TracksPerSlab];
+        track = new (&slot) Track(std::move(loaded));
+        m_trackCount++;
+    }
+    // Aliasing constructor: no control block per track, the arena is the owner
+    return std::shared_ptr<Track>(shared_from_this(), track);
+}
+
+char* TrackArena::allocate(std::size_t size)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    m_bytesAllocated += size;
+    if (size > BytesPerBlock / 4)
+    {
+        // Large buffers get their own block, so that the current block is not wasted
+        m_blocks.emplace_back(new char[size]);
+        return m_blocks.back().get();
+    }
+
+    if (size > m_blockRemaining)
+    {
+        m_blocks.emplace_back(new char[BytesPerBlock]);
+        m_blockCursor = m_blocks.back().get();
+        m_blockRemaining = BytesPerBlock;
+    }
+    auto result = m_blockCursor;
+    m_blockCursor += size;
+    m_blockRemaining -= size;
+    return result;
+}
+
+void TrackArena::deallocate(char* data, std::size_t size)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    if (size > BytesPerBlock / 4)
+    {
+        if (!m_blocks.empty() && m_blocks.back().get() == data)
+        {
+            m_blocks.pop_back();
+            m_bytesAllocated -= size;
+        }
+    }
+    else if (data + size == m_blockCursor)
+    {
+        m_blockCursor = data;
+        m_blockRemaining += size;
+        m_bytesAllocated -= size;
+    }
+}
+
+std::size_t TrackArena::trackCount() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_trackCount;
+}
+
+std::size_t TrackArena::bytesAllocated() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_bytesAllocated;
+}
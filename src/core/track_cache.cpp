@@ -0,0 +1,144 @@
+#include "core/track_cache.hpp"
+
+namespace fs = std::filesystem;
+
+TrackCache& TrackCache::instance()
+{
+    static TrackCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Track> TrackCache::load(const fs::path& path, TrackLoadMode mode)
+{
+    std::error_code ec;
+    auto canonical = fs::weakly_canonical(path, ec);
+    auto mtime = fs::last_write_time(path, ec);
+    auto fileSize = ec ? 0 : fs::file_size(path, ec);
+    if (ec)
+    {
+        // Not a readable file, nothing to cache
+        auto track = std::make_shared<Track>();
+        return track->initFromFile(path, mode) ? track : nullptr;
+    }
+
+    auto key = canonical.string();
+    key += '\0';
+    key += static_cast<char>('0' + static_cast<int>(mode));
+
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            auto entry = it->second;
+            if (entry->mtime == mtime && entry->fileSize == fileSize)
+            {
+                m_lru.splice(m_lru.begin(), m_lru, entry);
+                m_hits++;
+                return entry->track;
+            }
+            // Stale
+            m_bytesUsed -= entry->bytes;
+            m_lru.erase(entry);
+            m_index.erase(it);
+        }
+        m_misses++;
+    }
+
+    // Loaded without the lock, imports load many files in parallel. Cached tracks are allocated on
+    // their own rather than in a playlist's arena, which they would keep alive.
+    auto track = std::make_shared<Track>();
+    if (!track->initFromFile(path, mode))
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        // Loaded by another thread meanwhile
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->track;
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.mtime = mtime;
+    entry.fileSize = fileSize;
+    // Only the heap is charged, the content of a memory-mapped track lives in the page cache. The content
+    // of a lazy track is charged too: the playlists sharing the track load it into the track, where it
+    // stays until one of them evicts it.
+    entry.bytes = sizeof(Track);
+    if (mode == TrackLoadMode::Copy)
+    {
+        entry.bytes += static_cast<std::size_t>(fileSize);
+    }
+    else if (mode == TrackLoadMode::Lazy)
+    {
+        entry.bytes += track->contentSize();
+    }
+    entry.track = track;
+    m_lru.push_front(std::move(entry));
+    m_index.emplace(key, m_lru.begin());
+    m_bytesUsed += m_lru.front().bytes;
+    evictOverBudget();
+    return track;
+}
+
+void TrackCache::evictOverBudget()
+{
+    // The most recent entry stays, even alone over the budget
+    while (m_bytesUsed > m_budget && m_lru.size() > 1)
+    {
+        auto& oldest = m_lru.back();
+        m_bytesUsed -= oldest.bytes;
+        m_index.erase(oldest.key);
+        m_lru.pop_back();
+    }
+}
+
+void TrackCache::setBudget(std::size_t bytes)
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    m_budget = bytes;
+    evictOverBudget();
+}
+
+std::size_t TrackCache::budget() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_budget;
+}
+
+std::size_t TrackCache::bytesUsed() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_bytesUsed;
+}
+
+std::size_t TrackCache::size() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_lru.size();
+}
+
+std::uint64_t TrackCache::hits() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_hits;
+}
+
+std::uint64_t TrackCache::misses() const
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    return m_misses;
+}
+
+void TrackCache::clear()
+{
+    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+    m_bytesUsed = 0;
+}
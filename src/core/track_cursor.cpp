@@ -0,0 +1,70 @@
+#include <algorithm>
+#include "core/track_cursor.hpp"
+#include "core/helper.hpp"
+
+TrackCursor::TrackCursor(std::shared_ptr<const Track> track)
+{
+    reset(std::move(track));
+}
+
+void TrackCursor::reset(std::shared_ptr<const Track> track)
+{
+    m_track = std::move(track);
+    m_pin = m_track ? m_track->pinContent() : ContentPin();
+    m_position = 0;
+}
+
+void TrackCursor::rewind()
+{
+    m_position = 0;
+}
+
+const std::shared_ptr<const Track>& TrackCursor::track() const
+{
+    return m_track;
+}
+
+char TrackCursor::next()
+{
+    if (endOfTrack())
+    {
+        return 0;
+    }
+    return m_pin.content[m_position++];
+}
+
+std::string_view TrackCursor::take(std::size_t count)
+{
+    auto chunk = remaining().substr(0, count);
+    m_position += chunk.size();
+    return chunk;
+}
+
+std::string_view TrackCursor::takeFor(std::chrono::steady_clock::duration slice)
+{
+    if (endOfTrack())
+    {
+        return {};
+    }
+    auto count = slice / helper::contentInterval(*m_track);
+    return take(static_cast<std::size_t>(std::max<decltype(count)>(count, 1)));
+}
+
+std::string_view TrackCursor::remaining() const
+{
+    if (endOfTrack())
+    {
+        return {};
+    }
+    return m_pin.content.substr(m_position);
+}
+
+std::size_t TrackCursor::position() const
+{
+    return m_position;
+}
+
+bool TrackCursor::endOfTrack() const
+{
+    return m_position >= m_pin.content.size();
+}
@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <tuple>
+#include "core/track_index.hpp"
+#include "core/track.hpp"
+
+namespace
+{
+// ASCII only, without the locale lookups of <cctype>
+bool isWordChar(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+char toLower(unsigned char c)
+{
+    return static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+}
+
+// Call onWord with each lowercased word of text
+template <typename OnWord>
+void forEachWord(std::string_view text, OnWord&& onWord)
+{
+    std::string word;
+    for (std::size_t i = 0; i <= text.size(); ++i)
+    {
+        auto c = i < text.size() ? static_cast<unsigned char>(text[i]) : 0;
+        if (i < text.size() && isWordChar(c))
+        {
+            word += toLower(c);
+        }
+        else if (!word.empty())
+        {
+            onWord(word);
+            word.clear();
+        }
+    }
+}
+} // namespace
+
+TrackIndex::Words TrackIndex::wordsOf(const Track& track, bool withContent)
+{
+    // Lowercased once, the words are views into it until they are deduplicated
+    std::string text;
+    text.reserve(track.title().size() + track.artist().size() + 2);
+    auto append = [&text](std::string_view field)
+    {
+        for (unsigned char c : field)
+        {
+            text += isWordChar(c) ? toLower(c) : ' ';
+        }
+        text += ' ';
+    };
+    append(track.title());
+    append(track.artist());
+    if (withContent)
+    {
+        bool wasLoaded = track.isContentLoaded();
+        {
+            auto pin = track.pinContent();
+            text.reserve(text.size() + pin.content.size());
+            append(pin.content);
+        }
+        if (!wasLoaded)
+        {
+            track.evictContent();
+        }
+    }
+
+    // Deduplicated in an open addressing table: sorting the views costs several times more
+    std::vector<std::string_view> table(64);
+    std::size_t count = 0;
+    Words words;
+    std::string_view view(text);
+    for (std::size_t start = 0; start < view.size();)
+    {
+        auto end = std::min(view.find(' ', start), view.size());
+        if (end != start)
+        {
+            auto word = view.substr(start, end - start);
+            if (2 * (count + 1) > table.size())
+            {
+                std::vector<std::string_view> larger(table.size() * 2);
+                for (auto entry : table)
+                {
+                    if (!entry.empty())
+                    {
+                        auto i = std::hash<std::string_view>()(entry) & (larger.size() - 1);
+                        while (!larger[i].empty())
+                        {
+                            i = (i + 1) & (larger.size() - 1);
+                        }
+                        larger[i] = entry;
+                    }
+                }
+                table.swap(larger);
+            }
+            auto i = std::hash<std::string_view>()(word) & (table.size() - 1);
+            while (!table[i].empty() && table[i] != word)
+            {
+                i = (i + 1) & (table.size() - 1);
+            }
+            if (table[i].empty())
+            {
+                table[i] = word;
+                words.emplace_back(word);
+                ++count;
+            }
+        }
+        start = end + 1;
+    }
+    return words;
+}
+
+void TrackIndex::index(Id id, const Words& words)
+{
+    std::vector<WordId> wordIds;
+    wordIds.reserve(words.size());
+    for (const auto& word : words)
+    {
+        auto newWordId = m_freeWordIds.empty() ? static_cast<WordId>(m_postings.size()) : m_freeWordIds.back();
+        auto [it, isNew] = m_words.try_emplace(word, newWordId);
+        if (isNew)
+        {
+            if (m_freeWordIds.empty())
+            {
+                m_postings.emplace_back();
+            }
+            else
+            {
+                m_freeWordIds.pop_back();
+            }
+            m_sortedWords.emplace_back(it->first, it->second);
+        }
+        wordIds.push_back(it->second);
+
+        auto& postings = m_postings[it->second];
+        if (!isNew && postings.empty())
+        {
+            --m_unusedWords;
+        }
+        if (postings.empty() || postings.back() < id)
+        {
+            postings.push_back(id);
+        }
+        else
+        {
+            postings.insert(std::lower_bound(postings.begin(), postings.end(), id), id);
+        }
+    }
+    m_wordsOfTrack[id] = std::move(wordIds);
+}
+
+TrackIndex::Id TrackIndex::add(const Words& words)
+{
+    auto id = m_nextId++;
+    index(id, words);
+    return id;
+}
+
+std::vector<TrackIndex::Id> TrackIndex::reserveIds(std::size_t count)
+{
+    std::vector<Id> ids(count);
+    for (auto& id : ids)
+    {
+        id = m_nextId++;
+    }
+    return ids;
+}
+
+void TrackIndex::replace(Id id, const Words& words)
+{
+    erase({id});
+    index(id, words);
+}
+
+void TrackIndex::erase(const std::vector<Id>& ids)
+{
+    // Each posting list is swept once, however many of the erased tracks it holds
+    std::vector<WordId> words;
+    for (auto id : ids)
+    {
+        auto it = m_wordsOfTrack.find(id);
+        if (it != m_wordsOfTrack.end())
+        {
+            words.insert(words.end(), it->second.begin(), it->second.end());
+            m_wordsOfTrack.erase(it);
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    for (auto word : words)
+    {
+        auto& postings = m_postings[word];
+        if (ids.size() < 8)
+        {
+            // A few tracks (removeTrack): find them instead of testing every posting
+            for (auto id : ids)
+            {
+                auto it = std::lower_bound(postings.begin(), postings.end(), id);
+                if (it != postings.end() && *it == id)
+                {
+                    postings.erase(it);
+                }
+            }
+        }
+        else
+        {
+            postings.erase(std::remove_if(postings.begin(), postings.end(),
+                                          [&ids](Id id) { return std::binary_search(ids.begin(), ids.end(), id); }),
+                           postings.end());
+        }
+        if (postings.empty())
+        {
+            ++m_unusedWords;
+        }
+    }
+    // Dropping a word moves the sorted words after it: wait for many of them to drop them in one sweep
+    if (m_unusedWords > 64 && m_unusedWords > m_words.size() / 2)
+    {
+        dropUnusedWords();
+    }
+}
+
+void TrackIndex::dropUnusedWords()
+{
+    std::vector<bool> isUnused(m_postings.size(), false);
+    for (auto it = m_words.begin(); it != m_words.end();)
+    {
+        if (!m_postings[it->second].empty())
+        {
+            ++it;
+            continue;
+        }
+        isUnused[it->second] = true;
+        std::vector<Id>().swap(m_postings[it->second]);
+        m_freeWordIds.push_back(it->second);
+        it = m_words.erase(it);
+    }
+
+    // The views into the erased keys go too. Keeps both the sorted part and the pending tail in order.
+    std::size_t sortedCount = 0;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_sortedWords.size(); ++i)
+    {
+        if (!isUnused[m_sortedWords[i].second])
+        {
+            sortedCount += i < m_sortedCount;
+            m_sortedWords[kept++] = m_sortedWords[i];
+        }
+    }
+    m_sortedWords.resize(kept);
+    m_sortedCount = sortedCount;
+    m_unusedWords = 0;
+}
+
+void TrackIndex::clear()
+{
+    m_words.clear();
+    m_sortedWords.clear();
+    m_sortedCount = 0;
+    m_postings.clear();
+    m_freeWordIds.clear();
+    m_unusedWords = 0;
+    m_wordsOfTrack.clear();
+    m_nextId = 0;
+}
+
+std::size_t TrackIndex::wordCount() const
+{
+    return m_words.size() - m_unusedWords;
+}
+
+std::vector<TrackIndex::Id> TrackIndex::matchPrefix(const std::string& prefix, std::size_t limit) const
+{
+    {
+        // Concurrent searches would both sort otherwise. Once sorted, the words only change with the
+        // index, which the callers do not search meanwhile.
+        std::lock_guard<decltype(m_sortMutex)> lock(m_sortMutex);
+        if (m_sortedCount < m_sortedWords.size())
+        {
+            auto middle = m_sortedWords.begin() + m_sortedCount;
+            std::sort(middle, m_sortedWords.end());
+            std::inplace_merge(m_sortedWords.begin(), middle, m_sortedWords.end());
+            m_sortedCount = m_sortedWords.size();
+        }
+    }
+
+    std::vector<const std::vector<Id>*> lists;
+    std::string_view key(prefix);
+    for (auto it = std::lower_bound(m_sortedWords.begin(), m_sortedWords.end(), std::make_pair(key, WordId{0}));
+         it != m_sortedWords.end() && it->first.substr(0, key.size()) == key; ++it)
+    {
+        if (!m_postings[it->second].empty())
+        {
+            lists.push_back(&m_postings[it->second]);
+        }
+    }
+
+    // Merge the sorted posting lists through a heap of their heads (Id, list, position): each Id
+    // costs O(log lists), and the merge stops at limit
+    using Head = std::tuple<Id, std::size_t, std::size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (std::size_t list = 0; list < lists.size(); ++list)
+    {
+        heads.emplace(lists[list]->front(), list, 0);
+    }
+    std::vector<Id> ids;
+    while (!heads.empty() && ids.size() < limit)
+    {
+        auto [id, list, pos] = heads.top();
+        heads.pop();
+        if (ids.empty() || ids.back() != id)
+        {
+            ids.push_back(id);
+        }
+        if (++pos < lists[list]->size())
+        {
+            heads.emplace((*lists[list])[pos], list, pos);
+        }
+    }
+    return ids;
+}
+
+std::vector<TrackIndex::Id> TrackIndex::search(std::string_view query, std::size_t limit) const
+{
+    // Posting lists of the terms, the prefix ones merged into owned lists
+    std::vector<std::vector<Id>> merged;
+    std::vector<const std::vector<Id>*> lists;
+    std::vector<std::string> prefixes;
+    bool noMatch = false;
+
+    std::size_t start = 0;
+    while (start < query.size())
+    {
+        auto end = query.find_first_of(" \t", start);
+        if (end == std::string_view::npos)
+        {
+            end = query.size();
+        }
+        auto term = query.substr(start, end - start);
+        start = end + 1;
+
+        bool isPrefix = !term.empty() && term.back() == '*';
+        std::vector<std::string> words;
+        forEachWord(term, [&words](const std::string& word) { words.push_back(word); });
+        for (std::size_t i = 0; i < words.size(); ++i)
+        {
+            if (isPrefix && i + 1 == words.size())
+            {
+                prefixes.push_back(words[i]);
+                continue;
+            }
+            auto it = m_words.find(words[i]);
+            if (it == m_words.end())
+            {
+                noMatch = true;
+                break;
+            }
+            lists.push_back(&m_postings[it->second]);
+        }
+    }
+    if (noMatch)
+    {
+        return {};
+    }
+    // A lone prefix term is the result itself: its merge stops at limit
+    bool onlyPrefix = lists.empty() && prefixes.size() == 1;
+    merged.reserve(prefixes.size());
+    for (const auto& prefix : prefixes)
+    {
+        merged.push_back(matchPrefix(prefix, onlyPrefix ? limit : std::numeric_limits<std::size_t>::max()));
+        lists.push_back(&merged.back());
+    }
+    if (lists.empty())
+    {
+        return {};
+    }
+
+    // Walk the shortest list, look the others up
+    std::sort(lists.begin(), lists.end(), [](auto* a, auto* b) { return a->size() < b->size(); });
+    std::vector<Id> result;
+    for (auto id : *lists.front())
+    {
+        if (result.size() >= limit)
+        {
+            break;
+        }
+        bool matchesAll = std::all_of(lists.begin() + 1, lists.end(), [id](auto* list)
+                                      { return std::binary_search(list->begin(), list->end(), id); });
+        if (matchesAll)
+        {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,25 @@
+#include "core/wakeup_signal.hpp"
+
+bool WakeupSignal::waitUntil(Clock::time_point deadline)
+{
+    std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+    bool notified = m_cv.wait_until(lock, deadline, [this] { return m_notified; });
+    m_notified = false;
+    return notified;
+}
+
+void WakeupSignal::wait()
+{
+    std::unique_lock<decltype(m_mutex)> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_notified; });
+    m_notified = false;
+}
+
+void WakeupSignal::notify()
+{
+    {
+        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+        m_notified = true;
+    }
+    m_cv.notify_one();
+}
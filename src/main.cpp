@@ -1,9 +1,175 @@
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "core/library_file.hpp"
+#include "core/output_sink.hpp"
+#include "core/playback_engine.hpp"
+#include "core/renderer.hpp"
 #include "ui/text_based_player.hpp"
 
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [mode]\n"
+              << "Without mode, run the interactive player. Modes:\n"
+              << "  --headless <folder> <sessions> <seconds>  stream the folder to concurrent sessions\n"
+              << "  --render <playlist|library> <output|-> [passes]  write the playlist at full speed\n"
+              << "  --replay <trace|-> [--fast]  drive the player with a command trace\n"
+              << "  --help  print this message" << std::endl;
+}
+
+// Parse a whole argument as a number in [1, INT_MAX], e.g. a count or a duration
+static bool parsePositive(const char* arg, unsigned& value)
+{
+    std::string_view text(arg);
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size() && value > 0
+        && value <= static_cast<unsigned>(std::numeric_limits<int>::max());
+}
+
+// Load test: stream the playlist to many concurrent sessions, without any UI
+static int runHeadless(const std::string& path, int numSessions, int seconds)
+{
+    auto playlist = std::make_shared<Playlist>();
+    ImportOptions options;
+    options.numThreads = 0;
+    playlist->importFromFolder(path, options);
+    if (playlist->size() == 0)
+    {
+        std::cerr << "No track imported from " << path << std::endl;
+        return 1;
+    }
+
+    std::vector<std::atomic<std::uint64_t>> received(numSessions);
+    PlaybackEngine engine(playlist);
+    std::vector<SessionId> sessions;
+    for (int i = 0; i < numSessions; ++i)
+    {
+        auto id = engine.openSession([&received, i](SessionId, std::string_view chunk)
+                                     { received[i].fetch_add(chunk.size(), std::memory_order_relaxed); },
+                                     static_cast<unsigned>(i));
+        engine.post(id, SessionCommand::Repeat); // repeat all
+        engine.post(id, SessionCommand::Play);
+        sessions.push_back(id);
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+    std::uint64_t total = 0;
+    for (auto& bytes : received)
+    {
+        total += bytes.load(std::memory_order_relaxed);
+    }
+    for (auto id : sessions)
+    {
+        engine.closeSession(id);
+    }
+    std::cout << numSessions << " sessions streamed " << total << " bytes in " << seconds << "s" << std::endl;
+    return 0;
+}
+
+// Write the whole playlist (playlist file or compiled library) to output, "-" for the standard output.
+// repeatCount > 1 renders that many passes over the playlist.
+static int runRender(const std::string& path, const std::string& output, unsigned repeatCount)
+{
+    std::shared_ptr<Playlist> playlist;
+    if (library::isLibraryFile(path))
+    {
+        playlist = library::load(path);
+    }
+    else
+    {
+        playlist = std::make_shared<Playlist>();
+        ImportOptions options;
+        options.numThreads = DefaultImportThreads;
+        playlist->importFromFile(path, options);
+    }
+    if (!playlist || playlist->size() == 0)
+    {
+        std::cerr << "No track imported from " << path << std::endl;
+        return 1;
+    }
+
+    if (repeatCount > 1)
+    {
+        playlist->repeat(); // whole playlist
+    }
+
+    ContentWriter writer;
+    if (output != "-" && !writer.open(output))
+    {
+        std::cerr << "Cannot open " << output << std::endl;
+        return 1;
+    }
+
+    render::Options options;
+    options.repeatCount = repeatCount;
+    auto stats = render::renderPlaylist(*playlist, writer, options);
+    std::cerr << "Rendered " << stats.tracks << " tracks, " << stats.bytes << " bytes at "
+              << stats.megabytesPerSecond() << " MB/s" << std::endl;
+    return stats.ok ? 0 : 1;
+}
+
+// Drive the player with a command trace ("-" for the standard input) and report the command latencies.
+// fast replays the trace as fast as possible instead of at the recorded times.
+static int runReplay(const std::string& path, bool fast)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path);
+        if (!file)
+        {
+            std::cerr << "Cannot open " << path << std::endl;
+            return 1;
+        }
+    }
+    std::istream& trace = path == "-" ? std::cin : file;
+
+    LatencyStats latencies;
+    {
+        TextBasedPlayer player;
+        player.init();
+        latencies = player.replay(trace, !fast);
+    }
+    OutputSink::instance().flush();
+    latencies.report(std::cerr);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    std::string mode = argc > 1 ? argv[1] : "";
+    unsigned numSessions = 0;
+    unsigned seconds = 0;
+    if (mode == "--headless" && argc == 5 && parsePositive(argv[3], numSessions) && parsePositive(argv[4], seconds))
+    {
+        return runHeadless(argv[2], static_cast<int>(numSessions), static_cast<int>(seconds));
+    }
+    unsigned repeatCount = 1;
+    if (mode == "--render" && (argc == 4 || (argc == 5 && parsePositive(argv[4], repeatCount))))
+    {
+        return runRender(argv[2], argv[3], repeatCount);
+    }
+    if (mode == "--replay" && (argc == 3 || (argc == 4 && std::string(argv[3]) == "--fast")))
+    {
+        return runReplay(argv[2], argc == 4);
+    }
+    if (argc > 1)
+    {
+        printUsage(argv[0]);
+        return mode == "--help" ? 0 : 1;
+    }
+
     TextBasedPlayer player;
     player.init();
     player.run();
     return 0;
-}
\ No newline at end of file
+}
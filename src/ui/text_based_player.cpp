@@ -1,17 +1,48 @@
+#ifdef _WIN32
 #include <windows.h>
 #include <winuser.h>
 #include <conio.h>
+#endif
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <filesystem>
 #include "ui/text_based_player.hpp"
 #include "core/logger.hpp"
-#include "core/constants.hpp"
+#include "core/console_input.hpp"
+#ifndef _WIN32
+#include "core/event_loop.hpp"
+#endif
+#include "core/library_file.hpp"
+#include "core/renderer.hpp"
 
 namespace fs = std::filesystem;
 
+static std::uint64_t toMicroseconds(std::chrono::steady_clock::duration duration)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return us > 0 ? static_cast<std::uint64_t>(us) : 0;
+}
+
+// How the player loads track files, for imports and added tracks alike
+static ImportOptions playerImportOptions()
+{
+    ImportOptions options;
+    options.numThreads = DefaultImportThreads;
+    options.loadMode = TrackLoadMode::Lazy;
+    // Playlists often share track files
+    options.useCache = true;
+    options.indexContent = true;
+    return options;
+}
+
 TextBasedPlayer::~TextBasedPlayer()
 {
-    m_streamingThread.join();
+    if (m_streamingThread.joinable())
+    {
+        m_streamingThread.join();
+    }
 }
 
 void TextBasedPlayer::printHelp()
@@ -21,11 +52,13 @@ void TextBasedPlayer::printHelp()
     LOG("----------------------------------------------------------");
     LOG("-> " << BOLD("'H', '?'") << ": print help");
     LOG("-> " << BOLD("'N'     ") << ": import playlist from file");
-    LOG("-> " << BOLD("'M'     ") << ": save playlist to a file");
+    LOG("-> " << BOLD("'M'     ") << ": save playlist to a file (compiled library if the name ends with " << library::FileExtension << ")");
     LOG("-> " << BOLD("'C'     ") << ": create an empty playlist");
     LOG("-> " << BOLD("'J'     ") << ": add track to the current playlist");
     LOG("-> " << BOLD("'K'     ") << ": remove a track from the current playlist");
     LOG("-> " << BOLD("'L'     ") << ": remove duplicated tracks from the current playlist");
+    LOG("-> " << BOLD("'F'     ") << ": render the whole playlist at full speed to a file or the console");
+    LOG("-> " << BOLD("'G'     ") << ": search the title, artist and content of the tracks and jump to a match");
     LOG("-> " << BOLD("'Z'     ") << ": play");
     LOG("-> " << BOLD("'X'     ") << ": pause");
     LOG("-> " << BOLD("'D'     ") << ": next track");
@@ -33,30 +66,44 @@ void TextBasedPlayer::printHelp()
     LOG("-> " << BOLD("'S'     ") << ": shuffle/unshuffle");
     LOG("-> " << BOLD("'R'     ") << ": change repeat mode (none/repeat all/repeat currentsong)");
     LOG("-> " << BOLD("'I'     ") << ": current playlist info");
+    LOG("-> " << BOLD("'U'     ") << ": current track info");
+    LOG("-> " << BOLD("'T'     ") << ": runtime statistics (latencies in microseconds)");
     LOG("-> " << BOLD("'Q'     ") << ": quit");
     LOG("----------------------------------------------------------");
 }
 
 int TextBasedPlayer::importPlaylist()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
     LOG_COMMAND(CYAN("IMPORT PLAYLIST"));
-    pause(true);
     std::string pathString;
-    std::cout << "Enter playlist file information: ";
-    std::cin >> pathString;
+    PROMPT("Enter playlist file information", pathString);
     fs::path currentPath = fs::current_path();
     auto path = fs::path(pathString);
     if (path.is_relative())
     {
         path = currentPath / path;
     }
-    auto playlist = std::make_shared<Playlist>();
-    auto count = playlist->importFromFile(path);
-    if (playlist->isValid())
+
+    // Loaded on the input thread, the streaming thread only swaps it in
+    std::shared_ptr<Playlist> playlist;
+    int count = 0;
+    if (library::isLibraryFile(path))
+    {
+        playlist = library::load(path, true);
+        count = playlist ? playlist->size() : 0;
+    }
+    else
     {
-        m_playlist.swap(playlist);
-        m_currentTrack = m_playlist->resetToFirstTrack();
+        playlist = std::make_shared<Playlist>();
+        count = playlist->importFromFile(path, playerImportOptions());
+    }
+
+    if (playlist && playlist->isValid())
+    {
+        PlayerCommand command;
+        command.type = PlayerCommandType::SetPlaylist;
+        command.playlist = std::move(playlist);
+        postCommand(std::move(command));
     }
 
     if (count == 0)
@@ -70,123 +117,202 @@ int TextBasedPlayer::importPlaylist()
 void TextBasedPlayer::createPlaylist()
 {
     LOG_COMMAND(CYAN("CREATE PLAYLIST"));
-    m_playlist = std::make_shared<Playlist>();
+    auto playlist = std::make_shared<Playlist>();
     
     std::string s;
     PROMPT("Playlist Name", s);
-    m_playlist->setName(s);
+    playlist->setName(s);
 
     PROMPT("Playlist Description", s);
-    m_playlist->setDescription(s);
+    playlist->setDescription(s);
+
+    playlist->validate(true);
 
-    m_playlist->validate(true);
+    PlayerCommand command;
+    command.type = PlayerCommandType::SetPlaylist;
+    command.playlist = std::move(playlist);
+    postCommand(std::move(command));
 }
 
 void TextBasedPlayer::savePlaylist()
 {
     LOG_COMMAND(CYAN("SAVE PLAYLIST"));
-    if (!(m_playlist && m_playlist->isValid()))
-    {
-        WARN_MSG("No valid playlist available");
-        return;
-    }
-
     std::string pathString;
     PROMPT("Path", pathString);
     if (fs::exists(fs::path(pathString)))
     {
         std::string answer;
         PROMPT("Playlist already exists, enter 'yes' to overwrite? ", answer);
-        if (answer != std::string("yes"));
+        if (answer != std::string("yes"))
         {
             return;
         }
     }
 
-    m_playlist->exportToFile(pathString);
+    PlayerCommand command;
+    command.type = PlayerCommandType::SavePlaylist;
+    command.argument = pathString;
+    postCommand(std::move(command));
 }
 
 void TextBasedPlayer::addTrack()
 {
     LOG_COMMAND(CYAN("ADD TRACK"));
-    
-    if (!m_playlist)
-    {
-        WARN_MSG("No playlist available");
-        return;
-    }
-
-    bool wasPlaying = m_isPlaying;
-    if (wasPlaying)
-    {
-        pause();
-    }
     std::string pathString;
     PROMPT("Path", pathString);
     if (fs::exists(fs::path(pathString)) && fs::is_regular_file(fs::path(pathString)))
     {
-        TrackPtr track = std::make_shared<Track>();
-        track->initFromFile(fs::path(pathString));
-        m_playlist->addTrack(track);
+        PlayerCommand command;
+        command.type = PlayerCommandType::AddTrack;
+        command.argument = pathString;
+        postCommand(std::move(command));
     }
     else
     {
         WARN_MSG("File does not exist! Ignoring this command.");
     }
-    
-    if (wasPlaying)
-    {
-        play();
-    }
 }
 
 void TextBasedPlayer::removeTrack()
 {
     LOG_COMMAND(CYAN("REMOVE TRACK"));
-    if (!m_playlist)
+    PlayerCommand info;
+    info.type = PlayerCommandType::PlaylistInfo;
+    postCommand(std::move(info));
+
+    std::string indexStr;
+    PROMPT("Song index", indexStr);
+    PlayerCommand command;
+    command.type = PlayerCommandType::RemoveTrack;
+    try
     {
-        WARN_MSG("No playlist available");
+        command.index = std::stoi(indexStr);
+    }
+    catch (const std::exception&)
+    {
+        WARN_MSG("Invalid track index!");
         return;
     }
-    bool wasPlaying = m_isPlaying;
-    if (wasPlaying)
+    postCommand(std::move(command));
+}
+
+void TextBasedPlayer::removeDuplicate()
+{
+    LOG_COMMAND(CYAN("REMOVE DUPLICATE"));
+    std::string answer;
+    PROMPT("Compare by (T)itle and artist, (C)ontent or (P)ath [T]", answer);
+    PlayerCommand command;
+    command.type = PlayerCommandType::RemoveDuplicate;
+    if (!answer.empty() && toupper(answer[0]) == 'C')
     {
-        pause();
+        command.duplicateKey = DuplicateKey::Content;
     }
-    
-    currentPlaylistInfo();
-    std::string indexStr;
-    PROMPT("Song index", indexStr);
-    auto index = std::stoi(indexStr);
-    if (index <= m_playlist->size() && index >= 1)
+    else if (!answer.empty() && toupper(answer[0]) == 'P')
     {
-        if (m_playlist->removeTrack(index-1))
-        {
-            LOG("Track removed successfully!");
-            return;
-        }
+        command.duplicateKey = DuplicateKey::Path;
     }
-    else
+    postCommand(std::move(command));
+}
+
+void TextBasedPlayer::renderPlaylist()
+{
+    LOG_COMMAND(CYAN("RENDER PLAYLIST"));
+    PlayerCommand command;
+    command.type = PlayerCommandType::Render;
+    PROMPT("Path (empty for the console)", command.argument);
+
+    std::string countStr;
+    PROMPT("Passes over a repeating playlist [1]", countStr);
+    command.index = 1;
+    if (!countStr.empty())
     {
-        WARN_MSG("Track index out of bound!");
+        try
+        {
+            command.index = std::stoi(countStr);
+        }
+        catch (const std::exception&)
+        {
+            WARN_MSG("Invalid number, rendering a single pass");
+        }
     }
-    
-    if (wasPlaying)
+    postCommand(std::move(command));
+}
+
+void TextBasedPlayer::searchTrack()
+{
+    LOG_COMMAND(CYAN("SEARCH"));
+    PlayerCommand command;
+    command.type = PlayerCommandType::Search;
+    PROMPT("Words of the title, artist or content ('word*' for a prefix)", command.argument);
+    if (command.argument.empty())
     {
-        play();
+        return;
     }
+    postCommand(std::move(command));
 }
 
-void TextBasedPlayer::removeDuplicate()
+void TextBasedPlayer::jumpToMatch(const std::string& query)
 {
-    LOG_COMMAND(CYAN("REMOVE DUPLICATE"));
     if (!m_playlist)
     {
         WARN_MSG("No playlist available");
         return;
     }
 
-    m_playlist->removeDuplicate();
+    auto start = std::chrono::steady_clock::now();
+    auto matches = m_playlist->search(query);
+    auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+    if (matches.empty())
+    {
+        LOG("No track matches '" << query << "'");
+        return;
+    }
+
+    LOG("" << matches.size() << " track(s) match '" << query << "' (" << elapsed.count() << " us)");
+    const auto& tracks = m_playlist->tracks();
+    for (std::size_t i = 0; i < std::min(matches.size(), SearchResultsShown); ++i)
+    {
+        const auto& track = tracks[matches[i]];
+        LOG("" << matches[i] + 1 << ". '" << track->title() << "' by '" << track->artist() << "'");
+    }
+
+    auto current = m_playlist->currentTrackIndex();
+    auto it = std::upper_bound(matches.begin(), matches.end(), current);
+    auto target = it != matches.end() ? *it : matches.front();
+    auto startTransition = std::chrono::steady_clock::now();
+    m_cursor.reset(m_playlist->seek(target));
+    m_metrics.transitionTime.record(toMicroseconds(std::chrono::steady_clock::now() - startTransition));
+    m_nextTick = std::chrono::steady_clock::now();
+    LOG("Switching to '" << m_cursor.track()->title() << "' by '" << m_cursor.track()->artist() << "'");
+}
+
+void TextBasedPlayer::render(const std::string& path, unsigned repeatCount)
+{
+    if (!m_playlist || !m_playlist->isValid())
+    {
+        WARN_MSG("No valid playlist available");
+        return;
+    }
+
+    ContentWriter writer;
+    if (!path.empty() && !writer.open(fs::path(path)))
+    {
+        ERROR_LOG("Cannot open " << path);
+        return;
+    }
+
+    render::Options options;
+    options.repeatCount = std::max(repeatCount, 1u);
+    OutputSink::instance().flush(); // the console output goes straight to stdout
+    auto stats = render::renderPlaylist(*m_playlist, writer, options);
+    NEWLINE();
+    if (!stats.ok)
+    {
+        ERROR_LOG("Failed to write the rendered playlist");
+    }
+    LOG("Rendered " << stats.tracks << " track(s), " << stats.bytes << " bytes in "
+        << std::chrono::duration_cast<std::chrono::microseconds>(stats.elapsed).count() << " us ("
+        << stats.megabytesPerSecond() << " MB/s)");
 }
 
 void TextBasedPlayer::currentPlaylistInfo()
@@ -210,7 +336,8 @@ void TextBasedPlayer::currentPlaylistInfo()
     for (auto track : m_playlist->tracks())
     {   
         count++;
-        if (m_currentTrack && m_currentTrack == track)
+        // By index, the same (cached) track can appear several times
+        if (m_cursor.track() && count - 1 == m_playlist->currentTrackIndex())
         {
             LOG(">>> " << count << ". '" << track->title() 
                 << "' by '" << track->artist() << "'");
@@ -238,43 +365,58 @@ void TextBasedPlayer::currentTrackInfo()
         return;
     }
 
-    if (!m_currentTrack)
+    auto track = m_cursor.track();
+    if (!track)
     {
         LOG(RED("NO CURRENT TRACK IS SELECTED"));
     }
     else
     {
-        LOG(CYAN(BOLD("Title: " << m_currentTrack->title() << "")));
-        LOG(BOLD("Artist: ") << m_currentTrack->artist() << "");
-        LOG(BOLD("Codec: ") << m_currentTrack->codec() << "");
+        LOG(CYAN(BOLD("Title: " << track->title() << "")));
+        LOG(BOLD("Artist: ") << track->artist() << "");
+        LOG(BOLD("Codec: ") << track->codec() << "");
     }
     LOG(BOLD("########################################################"));
 }
 
-void TextBasedPlayer::streamCurrentSong()
+void TextBasedPlayer::printStats()
 {
-    if (!m_currentTrack || !m_playlist || !m_playlist->isValid())
+    LOG_COMMAND(CYAN("STATS"));
+    std::ostringstream stats;
+    writeStats(stats);
+    std::istringstream lines(stats.str());
+    for (std::string line; std::getline(lines, line);)
     {
-        return;
+        LOG("" << line << "");
     }
+}
 
-    while (m_currentTrack && !m_currentTrack->endOfTrack() && m_isRunning)
-    {
-        if (!m_isPlaying)
-        {
-            std::unique_lock<decltype(m_mutex)> lock(m_mutex);
-            m_cv.wait(lock);
-        }
-        else
+void TextBasedPlayer::writeStats(std::ostream& out) const
+{
+    Histogram::printHeader(out);
+    m_metrics.commandLatency.print(out, "command_latency_us");
+    m_metrics.queueDepth.print(out, "queue_depth");
+    m_metrics.tickLateness.print(out, "tick_lateness_us");
+    m_metrics.transitionTime.print(out, "transition_us");
+    out << "output_dropped " << OutputSink::instance().droppedCount() << '\n';
+}
+
+void TextBasedPlayer::streamCurrentSong()
+{
+    auto now = std::chrono::steady_clock::now();
+    m_metrics.tickLateness.record(toMicroseconds(now - m_nextTick));
+    if (!m_cursor.endOfTrack())
+    {
+        // Everything due since the last tick (one character when on time) goes out as one message
+        auto interval = helper::contentInterval(*m_cursor.track());
+        auto chunk = m_cursor.takeFor(now - m_nextTick + interval);
+        OutputSink::instance().writeContent(std::string(chunk));
+        // Deadlines are not shifted by the time spent writing, unless we are a whole tick late
+        m_nextTick += interval * static_cast<std::chrono::steady_clock::rep>(chunk.size());
+        if (m_nextTick + interval < now)
         {
-            std::cout << m_currentTrack->streamCurrentContent();
-            std::this_thread::sleep_for(DelayBetweenContent);
+            m_nextTick = now;
         }
-    }
-
-    if (!m_isRunning)
-    {
-        LOG("Quitting the application!");
         return;
     }
 
@@ -283,11 +425,12 @@ void TextBasedPlayer::streamCurrentSong()
         m_isPlaying = false;
         LOG("Press "<< GREEN("PLAY") << " to replay to the current playlist!");
     }
+    // From now, taken before the transition: a slow one (the prefetch missed) shortens the pause
+    m_nextTick = now + DelayBetweenTracks;
 }
 
 void TextBasedPlayer::play()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
     LOG_COMMAND(GREEN("PLAY"));
     if (!m_playlist || !m_playlist->isValid())
     {
@@ -297,59 +440,50 @@ void TextBasedPlayer::play()
 
     if (!m_isPlaying)
     {
-        if (!m_currentTrack)
+        if (!m_cursor.track())
         {
-            m_currentTrack = m_playlist->resetToFirstTrack();
+            m_cursor.reset(m_playlist->resetToFirstTrack());
         }
         else
         {
-            m_currentTrack = m_playlist->currentTrack();
+            // Resume where the track was paused
+            auto track = m_playlist->currentTrack();
+            if (track != m_cursor.track())
+            {
+                m_cursor.reset(track);
+            }
         }
         
-        if (m_currentTrack)
+        if (auto track = m_cursor.track())
         {
             m_isPlaying = true;
-            LOG("Current track: '" << m_currentTrack->title() 
-            << "' by '" << m_currentTrack->artist() << "'");
+            LOG("Current track: '" << track->title() 
+            << "' by '" << track->artist() << "'");
         }
         else
         {
             LOG("No track in your playlist!");
         }
     }
-    m_cv.notify_one();
 }
 
 void TextBasedPlayer::pause(bool autopause)
 {
     if (!autopause)
     {
-        std::lock_guard<decltype(m_mutex)> lock(m_mutex);
         LOG_COMMAND(YELLOW("PAUSE"));
-        m_isPlaying = false;
     }
-    else
-    {
-        m_isPlaying = false;
-    }
-    
+    m_isPlaying = false;
 }
 
 bool TextBasedPlayer::next(bool autoplay)
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
-    
     if (!m_playlist)
     {
         WARN_MSG("No playlist available");
         return false;
     }
 
-    if (m_currentTrack)
-    {
-        m_currentTrack->resetCurrentContentIndex();
-    }
-    
     if (!autoplay)
     {
         LOG_COMMAND(CYAN("NEXT TRACK"));
@@ -360,12 +494,14 @@ bool TextBasedPlayer::next(bool autoplay)
         LOG("Switching back repeat mode to " << YELLOW(BOLD("WHOLE PLAYLIST")));
     }
 
-    m_currentTrack = m_playlist->nextTrack(autoplay);
+    auto start = std::chrono::steady_clock::now();
+    m_cursor.reset(m_playlist->nextTrack(autoplay));
+    m_metrics.transitionTime.record(toMicroseconds(std::chrono::steady_clock::now() - start));
     NEWLINE();
-    if (m_currentTrack)
+    if (auto track = m_cursor.track())
     {
-        LOG("Switching to the next song '" << m_currentTrack->title() 
-                    << "' by '" << m_currentTrack->artist() << "'");
+        LOG("Switching to the next song '" << track->title() 
+                    << "' by '" << track->artist() << "'");
         return true;
     }
     else
@@ -377,19 +513,21 @@ bool TextBasedPlayer::next(bool autoplay)
 
 bool TextBasedPlayer::previous()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
     LOG_COMMAND(CYAN("PREVIOUS TRACK"));
-    if (m_currentTrack)
+    if (!m_playlist)
     {
-        m_currentTrack->resetCurrentContentIndex();
+        WARN_MSG("No playlist available");
+        return false;
     }
-    
-    m_currentTrack = m_playlist->previousTrack();
+
+    auto start = std::chrono::steady_clock::now();
+    m_cursor.reset(m_playlist->previousTrack());
+    m_metrics.transitionTime.record(toMicroseconds(std::chrono::steady_clock::now() - start));
     NEWLINE();
-    if (m_currentTrack)
+    if (auto track = m_cursor.track())
     {
-        LOG("Switching to the previous song '" << m_currentTrack->title() 
-                    << "' by '" << m_currentTrack->artist() << "'");
+        LOG("Switching to the previous song '" << track->title() 
+                    << "' by '" << track->artist() << "'");
         return true;
     }
     else
@@ -401,7 +539,12 @@ bool TextBasedPlayer::previous()
 
 void TextBasedPlayer::shuffle()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    if (!m_playlist)
+    {
+        WARN_MSG("No playlist available");
+        return;
+    }
+
     if (!m_playlist->isShuffled())
     {
         LOG_COMMAND(CYAN("SHUFFLE"));
@@ -416,8 +559,13 @@ void TextBasedPlayer::shuffle()
 
 void TextBasedPlayer::repeat()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
     LOG_COMMAND(CYAN("REPEAT"));
+    if (!m_playlist)
+    {
+        WARN_MSG("No playlist available");
+        return;
+    }
+
     m_playlist->repeat();
     switch (m_playlist->getRepeatMode())
     {
@@ -437,15 +585,16 @@ void TextBasedPlayer::repeat()
 
 void TextBasedPlayer::init()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
+    if (const char* path = std::getenv("IMPLAYER_METRICS_FILE"))
+    {
+        m_metricsFile = path;
+    }
 }
 
 void TextBasedPlayer::terminate()
 {
-    std::lock_guard<decltype(m_mutex)> lock(m_mutex);
     LOG_COMMAND(RED("TERMINATE"));
     m_isRunning = false;
-    m_cv.notify_all();
 }
 
 void TextBasedPlayer::run()
@@ -454,83 +603,400 @@ void TextBasedPlayer::run()
     LOG(BOLD(">>>> Press 'N' to import your playlist from file <<<<"));
     LOG(BOLD(">>>> Press 'H' or '?' to get help <<<<"));
     m_isRunning = true;
-    m_streamingThread = std::thread([this]
+    m_streamingThread = std::thread([this] { streamingLoop(); });
+
+    startCommandHandler();
+}
+
+LatencyStats TextBasedPlayer::replay(std::istream& trace, bool realTime)
+{
+    LatencyStats latencies;
+    m_latencies = &latencies;
+    auto& input = ConsoleInput::instance();
+    input.setScripted(true);
+
+    m_isRunning = true;
+    m_streamingThread = std::thread([this] { streamingLoop(); });
+
+    auto start = std::chrono::steady_clock::now();
+    std::string line;
+    bool hasLine = static_cast<bool>(std::getline(trace, line));
+    bool quit = false;
+    while (hasLine && !quit)
+    {
+        std::istringstream entry(line);
+        long long timestampMs = 0;
+        char key = 0;
+        if (line.empty() || line[0] == '#' || !(entry >> timestampMs >> key))
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                WARN_MSG("Invalid trace line: " << line);
+            }
+            hasLine = static_cast<bool>(std::getline(trace, line));
+            continue;
+        }
+
+        // The answers to the prompts of the key
+        while ((hasLine = static_cast<bool>(std::getline(trace, line))) && !line.empty() && line[0] == '>')
+        {
+            auto answer = line.substr(1);
+            if (!answer.empty() && answer[0] == ' ')
+            {
+                answer.erase(0, 1);
+            }
+            input.pushScriptedLine(std::move(answer));
+        }
+
+        if (realTime)
+        {
+            std::this_thread::sleep_until(start + std::chrono::milliseconds(timestampMs));
+        }
+        quit = !handleKey(key);
+        input.setScripted(true); // drop the answers left unread
+    }
+
+    if (!quit)
+    {
+        m_keyPressedAt = std::chrono::steady_clock::now();
+        PlayerCommand command;
+        command.type = PlayerCommandType::Quit;
+        postCommand(std::move(command));
+    }
+    m_streamingThread.join();
+    input.setScripted(false);
+    m_latencies = nullptr;
+    return latencies;
+}
+
+void TextBasedPlayer::postCommand(PlayerCommand&& command)
+{
+    command.keyPressedAt = m_keyPressedAt;
+    command.postedAt = std::chrono::steady_clock::now();
+    // The queue only fills up if the streaming thread is stuck in a long command: wait for room
+    while (!m_commands.tryPush(std::move(command)))
+    {
+        std::this_thread::yield();
+    }
+    m_wakeup.notify();
+}
+
+void TextBasedPlayer::streamingLoop()
+{
+    while (m_isRunning)
     {
-        while (m_isRunning)
+        processCommands();
+        if (!m_isRunning)
+        {
+            break;
+        }
+
+        if (!(m_isPlaying && m_cursor.track()))
+        {
+            // Nothing to stream until a command comes in
+            m_wakeup.wait();
+            continue;
+        }
+
+        prefetchNextTrack();
+        if (std::chrono::steady_clock::now() >= m_nextTick)
         {
             streamCurrentSong();
-            std::this_thread::sleep_for(DelayBetweenTracks);
         }
-    });
+        m_wakeup.waitUntil(m_nextTick);
+    }
+    LOG("Quitting the application!");
 
-    startCommandHandler();
+    if (!m_metricsFile.empty())
+    {
+        std::ofstream out(m_metricsFile);
+        writeStats(out);
+        if (!out)
+        {
+            WARN_MSG("Failed to write the metrics to " << m_metricsFile);
+        }
+    }
 }
 
-void TextBasedPlayer::startCommandHandler()
+void TextBasedPlayer::prefetchNextTrack()
+{
+    // Nothing to do unless the next track changed (new track, shuffle, repeat, playlist edit), then
+    // O(content window)
+    if (!m_playlist)
+    {
+        return;
+    }
+    auto next = m_playlist->peekNextTrack();
+    if (next == m_prefetched)
+    {
+        return;
+    }
+    m_prefetched = next;
+    // The current track changed too: drop the content which went out of the window
+    m_playlist->evictContent();
+    if (next)
+    {
+        m_prefetcher.submit([next] { next->prefetch(); });
+    }
+}
+
+void TextBasedPlayer::processCommands()
 {
-    int charCommand;
-    do
+    auto depth = m_commands.size();
+    if (depth > 0)
     {
-        charCommand = _getch();
-        charCommand = toupper(charCommand);
-        if (m_isPlaying)
+        m_metrics.queueDepth.record(depth);
+    }
+
+    PlayerCommand command;
+    while (m_commands.tryPop(command))
+    {
+        applyCommand(command);
+        auto appliedAt = std::chrono::steady_clock::now();
+        m_metrics.commandLatency.record(toMicroseconds(appliedAt - command.postedAt));
+        if (m_latencies)
         {
-            NEWLINE();
+            // What a replayed key costs, e.g. the import of 'N' done on the input thread included
+            m_latencies->record(toString(command.type), appliedAt - command.keyPressedAt);
         }
-        switch (charCommand)
+    }
+}
+
+void TextBasedPlayer::applyCommand(PlayerCommand& command)
+{
+    switch (command.type)
+    {
+    case PlayerCommandType::Play:
+        play();
+        m_nextTick = std::chrono::steady_clock::now();
+        break;
+    case PlayerCommandType::Pause:
+        pause();
+        break;
+    case PlayerCommandType::Next:
+        next();
+        m_nextTick = std::chrono::steady_clock::now();
+        break;
+    case PlayerCommandType::Previous:
+        previous();
+        m_nextTick = std::chrono::steady_clock::now();
+        break;
+    case PlayerCommandType::Shuffle:
+        shuffle();
+        break;
+    case PlayerCommandType::Repeat:
+        repeat();
+        break;
+    case PlayerCommandType::PlaylistInfo:
+        currentPlaylistInfo();
+        break;
+    case PlayerCommandType::TrackInfo:
+        currentTrackInfo();
+        break;
+    case PlayerCommandType::SetPlaylist:
+        pause(true);
+        m_playlist = std::move(command.playlist);
+        m_cursor.reset(m_playlist->resetToFirstTrack());
+        break;
+    case PlayerCommandType::SavePlaylist:
+        if (!(m_playlist && m_playlist->isValid()))
         {
-        case 'H':
-        case '?':
-            printHelp();
-            break;
-        case 'N':
-            importPlaylist();
-            break;
-        case 'M':
-            savePlaylist();
-            break;
-        case 'C':
-            createPlaylist();
-            break;
-        case 'J':
-            addTrack();
-            break;
-        case 'K':
-            removeTrack();
-            break;
-        case 'L':
-            removeDuplicate();
-            break;
-        case 'Z':
-            play();
-            break;
-        case 'X':
-            pause();
-            break;
-        case 'D':
-            next();
-            break;
-        case 'A':
-            previous();
-            break;
-        case 'S':
-            shuffle();
-            break;
-        case 'R':
-            repeat();
-            break;
-        case 'I':
-            currentPlaylistInfo();
-            break;
-        case 'U':
-            currentTrackInfo();
-            break;
-        case 'Q':
-            terminate();
-            break;
-        default:
-            break;
+            WARN_MSG("No valid playlist available");
+        }
+        else if (fs::path(command.argument).extension() == library::FileExtension)
+        {
+            library::compile(*m_playlist, command.argument);
+        }
+        else
+        {
+            m_playlist->exportToFile(command.argument);
+        }
+        break;
+    case PlayerCommandType::AddTrack:
+        if (!m_playlist)
+        {
+            WARN_MSG("No playlist available");
+        }
+        else if (!m_playlist->addTrackFromFile(fs::path(command.argument), playerImportOptions()))
+        {
+            WARN_MSG("Failed to load track " << command.argument);
+        }
+        break;
+    case PlayerCommandType::RemoveTrack:
+        if (!m_playlist)
+        {
+            WARN_MSG("No playlist available");
+        }
+        else if (command.index <= m_playlist->size() && command.index >= 1)
+        {
+            bool removedCurrent = command.index - 1 == m_playlist->currentTrackIndex();
+            if (m_playlist->removeTrack(command.index - 1))
+            {
+                if (removedCurrent)
+                {
+                    m_cursor.reset(m_playlist->currentTrack());
+                }
+                LOG("Track removed successfully!");
+            }
+        }
+        else
+        {
+            WARN_MSG("Track index out of bound!");
+        }
+        break;
+    case PlayerCommandType::RemoveDuplicate:
+        if (!m_playlist)
+        {
+            WARN_MSG("No playlist available");
+        }
+        else
+        {
+            auto count = m_playlist->removeDuplicate(command.duplicateKey);
+            auto track = m_playlist->currentTrack();
+            if (track != m_cursor.track())
+            {
+                m_cursor.reset(track);
+            }
+            LOG("Removed " << count << " duplicated track(s)");
         }
-    } while (m_isRunning);
+        break;
+    case PlayerCommandType::Stats:
+        printStats();
+        break;
+    case PlayerCommandType::Search:
+        jumpToMatch(command.argument);
+        break;
+    case PlayerCommandType::Render:
+        render(command.argument, static_cast<unsigned>(std::max(command.index, 1)));
+        break;
+    case PlayerCommandType::Quit:
+        terminate();
+        break;
+    default:
+        break;
+    }
 }
 
+bool TextBasedPlayer::handleKey(int key)
+{
+    m_keyPressedAt = std::chrono::steady_clock::now();
+    key = toupper(key);
+    if (m_isPlaying)
+    {
+        NEWLINE();
+    }
+
+    PlayerCommand command;
+    switch (key)
+    {
+    case 'H':
+    case '?':
+        printHelp();
+        break;
+    case 'N':
+        importPlaylist();
+        break;
+    case 'M':
+        savePlaylist();
+        break;
+    case 'C':
+        createPlaylist();
+        break;
+    case 'J':
+        addTrack();
+        break;
+    case 'K':
+        removeTrack();
+        break;
+    case 'L':
+        removeDuplicate();
+        break;
+    case 'F':
+        renderPlaylist();
+        break;
+    case 'G':
+        searchTrack();
+        break;
+    case 'Z':
+        command.type = PlayerCommandType::Play;
+        break;
+    case 'X':
+        command.type = PlayerCommandType::Pause;
+        break;
+    case 'D':
+        command.type = PlayerCommandType::Next;
+        break;
+    case 'A':
+        command.type = PlayerCommandType::Previous;
+        break;
+    case 'S':
+        command.type = PlayerCommandType::Shuffle;
+        break;
+    case 'R':
+        command.type = PlayerCommandType::Repeat;
+        break;
+    case 'I':
+        command.type = PlayerCommandType::PlaylistInfo;
+        break;
+    case 'U':
+        command.type = PlayerCommandType::TrackInfo;
+        break;
+    case 'T':
+        command.type = PlayerCommandType::Stats;
+        break;
+    case 'Q':
+        command.type = PlayerCommandType::Quit;
+        break;
+    default:
+        break;
+    }
+
+    bool quit = command.type == PlayerCommandType::Quit;
+    if (command.type != PlayerCommandType::None)
+    {
+        postCommand(std::move(command));
+    }
+    return !quit && m_isRunning;
+}
+
+#ifdef _WIN32
+void TextBasedPlayer::startCommandHandler()
+{
+    while (handleKey(_getch()))
+    {
+    }
+}
+#else
+void TextBasedPlayer::startCommandHandler()
+{
+    auto& input = ConsoleInput::instance();
+    input.enableRawMode();
+
+    // The input thread sleeps in poll() until a key comes in, keys typed ahead are handled in order
+    EventLoop loop;
+    loop.watch(ConsoleInput::Fd, [this, &input, &loop]
+    {
+        if (!input.readAvailable())
+        {
+            // End of the input: nothing will ever be typed again
+            PlayerCommand command;
+            command.type = PlayerCommandType::Quit;
+            postCommand(std::move(command));
+            loop.stop();
+            return;
+        }
+        char key;
+        while (input.nextKey(key))
+        {
+            if (!handleKey(key))
+            {
+                loop.stop();
+                return;
+            }
+        }
+    });
+    loop.run();
+
+    input.restoreMode();
+}
+#endif
@@ -0,0 +1,1235 @@
+// Unit tests of the core classes, without any framework: each failed CHECK prints its location and the
+// process exits with 1. Run by ctest.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "core/constants.hpp"
+#ifndef _WIN32
+#include "core/event_loop.hpp"
+#endif
+#include "core/histogram.hpp"
+#include "core/latency_stats.hpp"
+#include "core/library_file.hpp"
+#include "core/logger.hpp"
+#include "core/output_sink.hpp"
+#include "core/playback_engine.hpp"
+#include "core/playback_order.hpp"
+#include "core/playlist.hpp"
+#include "core/renderer.hpp"
+#include "core/string_pool.hpp"
+#include "core/track_arena.hpp"
+#include "core/track_cache.hpp"
+#include "core/track_cursor.hpp"
+#include "core/track_index.hpp"
+#include "ui/text_based_player.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+int failures = 0;
+
+#define CHECK(condition)                                                                      \
+    do                                                                                        \
+    {                                                                                         \
+        if (!(condition))                                                                     \
+        {                                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            failures++;                                                                       \
+        }                                                                                     \
+    } while (false)
+
+// Track indices in the order next(true) walks them from the first track
+std::vector<int> walk(PlaybackOrder order)
+{
+    std::vector<int> trackIndices;
+    // Bounded, in case the order loops
+    auto maxTracks = 2 * static_cast<std::size_t>(order.size());
+    for (int trackIdx = order.reset(); trackIdx != PlaybackOrder::NoTrack && trackIndices.size() <= maxTracks;
+         trackIdx = order.next(true))
+    {
+        trackIndices.push_back(trackIdx);
+    }
+    return trackIndices;
+}
+
+bool isPermutation(std::vector<int> trackIndices, int size)
+{
+    std::vector<int> expected(size);
+    std::iota(expected.begin(), expected.end(), 0);
+    std::sort(trackIndices.begin(), trackIndices.end());
+    return trackIndices == expected;
+}
+
+// The walk (permutation) and seek (inverse permutation) agree: the k-th track walked is k steps away
+// from the first one
+bool isConsistent(const PlaybackOrder& order)
+{
+    auto trackIndices = walk(order);
+    if (!isPermutation(trackIndices, order.size()))
+    {
+        return false;
+    }
+    auto copy = order;
+    copy.reset();
+    for (std::size_t k = 0; k < trackIndices.size(); ++k)
+    {
+        if (copy.distanceFromCurrent(trackIndices[k]) != static_cast<int>(k))
+        {
+            return false;
+        }
+    }
+    for (int trackIdx = 0; trackIdx < order.size(); ++trackIdx)
+    {
+        if (copy.seek(trackIdx) != trackIdx || copy.current() != trackIdx)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testSeededShuffle()
+{
+    PlaybackOrder first;
+    PlaybackOrder second;
+    first.assign(50);
+    second.assign(50);
+    first.seed(42);
+    second.seed(42);
+    first.shuffle();
+    second.shuffle();
+    CHECK(first.isShuffled());
+    CHECK(walk(first) == walk(second));
+    CHECK(isPermutation(walk(first), 50));
+    CHECK(isConsistent(first));
+
+    // The current track stays current when shuffling
+    PlaybackOrder order;
+    order.assign(20);
+    order.seed(7);
+    order.seek(12);
+    order.shuffle();
+    CHECK(order.current() == 12);
+
+    // A different seed draws another order
+    PlaybackOrder other;
+    other.assign(50);
+    other.seed(43);
+    other.shuffle();
+    CHECK(walk(other) != walk(first));
+
+    // Unshuffled, the tracks come in their own order
+    std::vector<int> inOrder(50);
+    std::iota(inOrder.begin(), inOrder.end(), 0);
+    first.unshuffle();
+    CHECK(walk(first) == inOrder);
+    first.shuffle();
+    CHECK(isConsistent(first));
+}
+
+void testReshuffle()
+{
+    PlaybackOrder order;
+    order.assign(30);
+    order.seed(1);
+    order.seek(5);
+    order.reshuffle();
+    CHECK(!order.isShuffled());
+    CHECK(order.current() == 5);
+    order.shuffle();
+    CHECK(order.current() == 5);
+    CHECK(isConsistent(order));
+
+    auto before = walk(order);
+    order.reshuffle();
+    CHECK(order.isShuffled());
+    CHECK(order.current() == 5);
+    CHECK(walk(order) != before);
+    CHECK(isConsistent(order));
+
+    // Assigned new tracks while shuffled, the order covers them
+    order.assign(40);
+    CHECK(order.isShuffled());
+    CHECK(isConsistent(order));
+}
+
+void testEraseAppend()
+{
+    std::mt19937 rng(3);
+    for (bool shuffled : {false, true})
+    {
+        PlaybackOrder order;
+        order.seed(11);
+        order.assign(40);
+        if (shuffled)
+        {
+            order.shuffle();
+        }
+        for (int step = 0; step < 200; ++step)
+        {
+            if (rng() % 2 == 0 || order.size() < 5)
+            {
+                order.append();
+            }
+            else
+            {
+                std::vector<bool> removed(order.size(), false);
+                for (int i = 0; i < 3; ++i)
+                {
+                    removed[rng() % order.size()] = true;
+                }
+                int current = order.current();
+                int keptBefore = static_cast<int>(std::count(removed.begin(), removed.begin() + current, false));
+                bool currentRemoved = removed[current];
+                order.erase(removed);
+                if (!currentRemoved)
+                {
+                    // Renumbered, still current
+                    CHECK(order.current() == keptBefore);
+                }
+            }
+            order.seek(static_cast<int>(rng() % order.size()));
+            CHECK(order.isShuffled() == shuffled);
+            CHECK(isConsistent(order));
+        }
+    }
+}
+
+void testPeekNext()
+{
+    // The prefetch resolves the track next(true) plays, whatever the shuffle and repeat modes
+    for (bool shuffled : {false, true})
+    {
+        PlaybackOrder order;
+        order.seed(5);
+        order.assign(10);
+        if (shuffled)
+        {
+            order.shuffle();
+        }
+        for (int mode = 0; mode < 3; ++mode)
+        {
+            order.reset();
+            for (int step = 0; step < 25 && order.current() != PlaybackOrder::NoTrack; ++step)
+            {
+                int peeked = order.peekNext();
+                CHECK(order.next(true) == peeked);
+            }
+            order.repeat();
+        }
+    }
+}
+
+std::shared_ptr<Track> makeTrack(const std::string& path, const std::string& title, const std::string& artist,
+                                 const std::string& content)
+{
+    auto track = std::make_shared<Track>();
+    track->initFromFields(path, title, artist, "mp3", 1000, {}, nullptr);
+    track->setContent(content); // a copy, the view of initFromFields() would outlive content
+    return track;
+}
+
+std::vector<std::string> titlesOf(const Playlist& playlist)
+{
+    std::vector<std::string> titles;
+    for (const auto& track : playlist.tracks())
+    {
+        titles.push_back(std::string(track->title()));
+    }
+    return titles;
+}
+
+void testStringPool()
+{
+    auto& pool = StringPool::instance();
+    std::string text = "Interned Artist";
+    auto first = pool.intern(text);
+    auto size = pool.size();
+    text[0] = 'X'; // the pool keeps its own copy
+    auto second = pool.intern("Interned Artist");
+    CHECK(first == second);
+    CHECK(first.view() == "Interned Artist");
+    CHECK(pool.size() == size);
+    CHECK(pool.intern(text) != first);
+    CHECK(InternedString().empty() && pool.intern("") == InternedString());
+
+    // Folded: normalized case and whitespace, shared by the spellings
+    CHECK(pool.intern("  interned   ARTIST ").folded() == first.folded());
+    CHECK(first.folded() != first);
+
+    // Tracks share the handles of their metadata
+    auto track1 = makeTrack("1.txt", "Title", "Interned Artist", "");
+    auto track2 = makeTrack("2.txt", "Other", "Interned Artist", "");
+    CHECK(track1->artistHandle() == track2->artistHandle() && track1->artistHandle() == first);
+
+    // Concurrent interning gives one handle per string
+    std::vector<std::thread> threads;
+    std::vector<InternedString> handles(4);
+    for (std::size_t t = 0; t < handles.size(); ++t)
+    {
+        threads.emplace_back([&handles, &pool, t]
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                handles[t] = pool.intern("concurrent" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(std::all_of(handles.begin(), handles.end(), [&handles](auto h) { return h == handles[0]; }));
+    CHECK(handles[0].view() == "concurrent999");
+}
+
+void testRemoveDuplicate()
+{
+    auto fill = [](Playlist& playlist)
+    {
+        playlist.addTrack(makeTrack("a.txt", "Song", "Artist", "one"));
+        playlist.addTrack(makeTrack("b.txt", "  song ", "ARTIST", "two")); // same title and artist
+        playlist.addTrack(makeTrack("c.txt", "Other", "Artist", "one")); // same content as the first
+        playlist.addTrack(makeTrack("a.txt", "Third", "Someone", "three")); // same path as the first
+        playlist.addTrack(makeTrack("d.txt", "Song", "Someone", "four"));
+    };
+
+    Playlist byTitle;
+    fill(byTitle);
+    byTitle.seek(4);
+    CHECK(byTitle.removeDuplicate(DuplicateKey::TitleArtist) == 1);
+    CHECK((titlesOf(byTitle) == std::vector<std::string>{"Song", "Other", "Third", "Song"}));
+    // The current track stays current, the index follows the new positions
+    CHECK(byTitle.currentTrack()->path() == "d.txt");
+    CHECK((byTitle.search("song") == std::vector<int>{0, 3}));
+
+    Playlist byContent;
+    fill(byContent);
+    CHECK(byContent.removeDuplicate(DuplicateKey::Content) == 1);
+    CHECK((titlesOf(byContent) == std::vector<std::string>{"Song", "  song ", "Third", "Song"}));
+
+    Playlist byPath;
+    fill(byPath);
+    CHECK(byPath.removeDuplicate(DuplicateKey::Path) == 1);
+    CHECK((titlesOf(byPath) == std::vector<std::string>{"Song", "  song ", "Other", "Song"}));
+    CHECK(byPath.removeDuplicate(DuplicateKey::Path) == 0);
+}
+
+void testPlaybackEngine()
+{
+    // 10 characters in 10 ms per track: streamed at the 1 ms minimum interval
+    auto library = std::make_shared<Playlist>();
+    std::string expected;
+    for (char c = 'a'; c <= 'e'; ++c)
+    {
+        auto track = std::make_shared<Track>();
+        track->initFromFields(std::string(1, c) + ".txt", std::string(1, c), "Artist", "mp3", 10, {}, nullptr);
+        track->setContent(std::string(10, c));
+        library->addTrack(track);
+        expected += std::string(10, c);
+    }
+
+    std::mutex mutex;
+    std::map<SessionId, std::string> received;
+    PlaybackEngine engine(library, 2, std::chrono::milliseconds(1));
+    auto sink = [&mutex, &received](SessionId id, std::string_view chunk)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        received[id] += chunk;
+    };
+    auto inOrder = engine.openSession(sink);
+    auto shuffled = engine.openSession(sink, 3u);
+    auto paused = engine.openSession(sink);
+    CHECK(engine.sessionCount() == 3);
+    engine.post(inOrder, SessionCommand::Play);
+    engine.post(shuffled, SessionCommand::Shuffle);
+    engine.post(shuffled, SessionCommand::Play);
+    engine.post(paused, SessionCommand::Play);
+    engine.post(paused, SessionCommand::Pause);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    auto playing = [&engine](SessionId id) { return engine.sessionState(id)->playing; };
+    // Stopped at the end of the playlist, the snapshot is only updated by the ticks
+    auto done = [&engine](SessionId id)
+    {
+        auto state = engine.sessionState(id);
+        return !state->playing && state->bytesStreamed > 0;
+    };
+    while (!(done(inOrder) && done(shuffled)) && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    CHECK(received[inOrder] == expected);
+    CHECK(engine.sessionState(inOrder)->bytesStreamed == expected.size());
+    // Every track once, from the current one
+    auto sorted = received[shuffled];
+    std::sort(sorted.begin(), sorted.end());
+    CHECK(sorted == expected && received[shuffled][0] == 'a');
+    CHECK(engine.sessionState(shuffled)->shuffled);
+    CHECK(received[paused].size() < expected.size() && !playing(paused));
+
+    engine.closeSession(paused);
+    CHECK(engine.sessionCount() == 2);
+    CHECK(!engine.post(paused, SessionCommand::Play));
+    CHECK(!engine.sessionState(paused));
+}
+
+void testTrackIndex()
+{
+    TrackIndex index;
+    auto first = index.add({"yellow", "submarine", "beatles"});
+    auto second = index.add({"help", "beatles"});
+    auto third = index.add({"yesterday", "beatles", "remastered"});
+    CHECK(first < second && second < third);
+    CHECK(index.wordCount() == 6);
+
+    CHECK((index.search("beatles") == std::vector<TrackIndex::Id>{first, second, third}));
+    CHECK((index.search("BEATLES help") == std::vector<TrackIndex::Id>{second}));
+    CHECK((index.search("ye*") == std::vector<TrackIndex::Id>{first, third}));
+    CHECK((index.search("beatles", 2) == std::vector<TrackIndex::Id>{first, second}));
+    CHECK(index.search("beatles unknown").empty());
+    CHECK(index.search("").empty());
+
+    index.replace(second, {"help", "remastered"});
+    CHECK((index.search("remastered") == std::vector<TrackIndex::Id>{second, third}));
+    CHECK((index.search("beatles") == std::vector<TrackIndex::Id>{first, third}));
+
+    index.erase({first, third});
+    CHECK((index.search("remastered") == std::vector<TrackIndex::Id>{second}));
+    CHECK(index.search("ye*").empty());
+    CHECK(index.wordCount() == 2);
+
+    // Reserved ids can be indexed in any order
+    auto ids = index.reserveIds(2);
+    index.replace(ids[1], {"late"});
+    index.replace(ids[0], {"late", "early"});
+    CHECK((index.search("late") == std::vector<TrackIndex::Id>{ids[0], ids[1]}));
+
+    auto track = std::make_shared<Track>();
+    track->initFromFields("a.txt", "Hello, World", "Some-Artist", "mp3", 1, "ignored words", nullptr);
+    auto words = TrackIndex::wordsOf(*track, false);
+    std::sort(words.begin(), words.end());
+    CHECK((words == TrackIndex::Words{"artist", "hello", "some", "world"}));
+    words = TrackIndex::wordsOf(*track, true);
+    CHECK(std::count(words.begin(), words.end(), "ignored") == 1);
+}
+
+void testPrefixMerge()
+{
+    // Interleaved posting lists, some tracks with several words of the prefix
+    TrackIndex index;
+    std::vector<TrackIndex::Id> all;
+    for (int i = 0; i < 100; ++i)
+    {
+        TrackIndex::Words words{"pre" + std::to_string(i % 7), "other"};
+        if (i % 3 == 0)
+        {
+            words.push_back("prefix");
+        }
+        all.push_back(index.add(words));
+    }
+    CHECK(index.search("pre*") == all);
+    CHECK((index.search("pre*", 5) == std::vector<TrackIndex::Id>(all.begin(), all.begin() + 5)));
+    CHECK((index.search("prefix*") == index.search("prefix")));
+    CHECK(index.search("other pre*", 3).size() == 3);
+    CHECK(index.search("pre1*").size() == 15); // pre1 only, 1, 8, ..., 99
+    CHECK(index.search("zzz*").empty());
+}
+
+void writeTrack(const fs::path& path, const std::string& title, const std::string& content)
+{
+    std::ofstream out(path);
+    out << "title " << title << "\nartist Artist\ncodec mp3\nduration 1000\ncontent " << content << "\n";
+}
+
+// Move the modification time forward, as a later write would
+void touch(const fs::path& path, int seconds)
+{
+    fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(seconds));
+}
+
+void testTrackCursor()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    writeTrack(folder / "track.txt", "Title", "abcdef");
+    auto track = std::make_shared<Track>();
+    CHECK(track->initFromFile(folder / "track.txt", TrackLoadMode::Lazy));
+
+    // Readers of the same track keep positions of their own
+    TrackCursor first(track);
+    TrackCursor second(track);
+    CHECK(first.next() == 'a' && first.next() == 'b');
+    CHECK(second.next() == 'a');
+    CHECK(first.position() == 2 && second.position() == 1);
+
+    // The content stays readable while a cursor holds it, even evicted by the track
+    CHECK(track->evictContent());
+    CHECK(first.remaining() == "cdef");
+    first.rewind();
+    CHECK(first.remaining() == "abcdef");
+
+    TrackCursor empty;
+    CHECK(empty.endOfTrack() && empty.next() == 0 && !empty.track());
+    fs::remove_all(folder);
+}
+
+void testChunkedStreaming()
+{
+    // 10 characters in 100 ms: one every 10 ms
+    auto track = std::make_shared<Track>();
+    track->initFromFields("track.txt", "Title", "Artist", "mp3", 100, {}, nullptr);
+    track->setContent("0123456789");
+    TrackCursor cursor(track);
+    CHECK(cursor.take(2) == "01");
+    CHECK(cursor.takeFor(std::chrono::milliseconds(35)) == "234");
+    // At least one character per call, even late by nothing
+    CHECK(cursor.takeFor(std::chrono::milliseconds(0)) == "5");
+    CHECK(cursor.take(100) == "6789");
+    CHECK(cursor.endOfTrack() && cursor.take(1).empty() && cursor.takeFor(std::chrono::seconds(1)).empty());
+
+    // Many chunks gathered in as few writes as possible, all written in order
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    std::vector<std::string> texts;
+    std::string expected;
+    for (int i = 0; i < 3000; ++i)
+    {
+        texts.push_back(std::to_string(i) + ",");
+        expected += texts.back();
+    }
+    std::vector<std::string_view> chunks(texts.begin(), texts.end());
+    {
+        ContentWriter writer;
+        CHECK(writer.open(folder / "out.txt"));
+        CHECK(writer.write(chunks.data(), chunks.size()));
+        CHECK(writer.write("end"));
+        CHECK(writer.bytesWritten() == expected.size() + 3);
+    }
+    std::ifstream in(folder / "out.txt");
+    std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(written == expected + "end");
+    fs::remove_all(folder);
+}
+
+void testParallelImport()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    std::ofstream playlistFile(folder / "playlist.list");
+    playlistFile << "Playlist\nDescription\n";
+    std::vector<std::string> expected;
+    for (int i = 0; i < 300; ++i)
+    {
+        auto name = "track" + std::string(i < 10 ? "00" : i < 100 ? "0" : "") + std::to_string(i);
+        if (i % 50 == 7)
+        {
+            std::ofstream(folder / (name + ".txt")) << "not a track\n";
+        }
+        else
+        {
+            writeTrack(folder / (name + ".txt"), "Title" + std::to_string(i), "content");
+            expected.push_back("Title" + std::to_string(i));
+        }
+        playlistFile << (folder / (name + ".txt")).string() << "\n";
+    }
+    playlistFile << (folder / "missing.txt").string() << "\n";
+    playlistFile.close();
+    // The playlist file itself fails to parse as a track when importing the folder
+    fs::rename(folder / "playlist.list", folder.parent_path() / (folder.filename().string() + ".list"));
+    auto playlistPath = folder.parent_path() / (folder.filename().string() + ".list");
+
+    for (unsigned numThreads : {1u, 4u, 0u})
+    {
+        for (auto mode : {TrackLoadMode::Copy, TrackLoadMode::Lazy})
+        {
+            ImportOptions options;
+            options.numThreads = numThreads;
+            options.loadMode = mode;
+            // In the file (or sorted folder) order whatever the threads, without the failed loads
+            Playlist fromFolder;
+            CHECK(fromFolder.importFromFolder(folder, options) == static_cast<int>(expected.size()));
+            Playlist fromFile;
+            CHECK(fromFile.importFromFile(playlistPath, options) == static_cast<int>(expected.size()));
+            for (auto* playlist : {&fromFolder, &fromFile})
+            {
+                std::vector<std::string> titles;
+                for (const auto& track : playlist->tracks())
+                {
+                    titles.push_back(std::string(track->title()));
+                }
+                CHECK(titles == expected);
+                CHECK((playlist->search("title123") == std::vector<int>{120})); // after 3 failed loads
+            }
+        }
+    }
+    fs::remove(playlistPath);
+    fs::remove_all(folder);
+}
+
+void testTrackParser()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    // Empty lines are skipped, CRLF line ends accepted and a key alone gets an empty value
+    std::ofstream(folder / "track.txt", std::ios::binary)
+        << "title Title\r\n\nartist\ncodec mp3\n\nduration 1000\ncontent some content\n";
+    std::ofstream(folder / "unknown.txt") << "title Title\nlyrics none\n";
+    std::ofstream(folder / "large.txt") << "title Large\ncontent " << std::string(MinMappedFileSize, 'x') << "\n";
+
+    for (auto mode : {TrackLoadMode::Copy, TrackLoadMode::MemoryMapped, TrackLoadMode::Lazy})
+    {
+        Track track;
+        CHECK(track.initFromFile(folder / "track.txt", mode));
+        CHECK(track.title() == "Title");
+        CHECK(track.artist().empty());
+        CHECK(track.codec() == "mp3");
+        CHECK(track.duration() == 1000);
+        CHECK(track.content() == "some content");
+
+        Track unknown;
+        CHECK(!unknown.initFromFile(folder / "unknown.txt", mode));
+
+        // Prefetching loads the content of a lazy track ahead of playback
+        track.evictContent();
+        track.prefetch();
+        CHECK(track.isContentLoaded());
+
+        Track large;
+        CHECK(large.initFromFile(folder / "large.txt", mode));
+        CHECK(large.content() == std::string(MinMappedFileSize, 'x'));
+    }
+
+#ifdef __linux__
+    // Small files are read, not mapped: each mapping would be one more line in /proc/self/maps
+    auto mappingCount = []
+    {
+        std::ifstream maps("/proc/self/maps");
+        return std::count(std::istreambuf_iterator<char>(maps), std::istreambuf_iterator<char>(), '\n');
+    };
+    auto before = mappingCount();
+    std::vector<Track> tracks(50);
+    for (auto& track : tracks)
+    {
+        track.initFromFile(folder / "track.txt", TrackLoadMode::MemoryMapped);
+    }
+    CHECK(mappingCount() < before + 10);
+#endif
+    fs::remove_all(folder);
+}
+
+void testLazyLoading()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 10; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i),
+                   "content" + std::to_string(i));
+    }
+    // Keys after the content: loaded whole instead
+    std::ofstream(folder / "track9.txt") << "title Title9\ncontent content9\nartist Late\n";
+
+    ImportOptions options;
+    options.loadMode = TrackLoadMode::Lazy;
+    Playlist playlist;
+    CHECK(playlist.importFromFolder(folder, options) == 10);
+    const auto& tracks = playlist.tracks();
+    // Metadata parsed, content not read yet
+    CHECK(tracks[3]->title() == "Title3" && tracks[3]->duration() == 1000);
+    CHECK(!tracks[3]->isContentLoaded());
+    CHECK(tracks[3]->contentSize() == 8);
+    CHECK(tracks[9]->isContentLoaded() && tracks[9]->artist() == "Late");
+
+    // Loaded on demand, evicted once out of the content window around the current track
+    playlist.setContentWindow(1);
+    playlist.seek(3);
+    CHECK(tracks[3]->content() == "content3");
+    CHECK(tracks[4]->content() == "content4");
+    playlist.evictContent();
+    CHECK(tracks[3]->isContentLoaded() && tracks[4]->isContentLoaded());
+    playlist.seek(6);
+    CHECK(playlist.evictContent() == 2);
+    CHECK(!tracks[3]->isContentLoaded() && !tracks[4]->isContentLoaded());
+    CHECK(tracks[3]->content() == "content3");
+    fs::remove_all(folder);
+}
+
+void testRescanJournal()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 3; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i), "content");
+    }
+
+    for (auto mode : {TrackLoadMode::Copy, TrackLoadMode::Lazy})
+    {
+        ImportOptions options;
+        options.loadMode = mode;
+        Playlist playlist;
+        CHECK(playlist.importFromFolder(folder, options) == 3);
+
+        auto diff = playlist.rescanFolder(options);
+        CHECK(diff.added.empty() && diff.removed.empty() && diff.updated.empty());
+
+        // Touched only, on the first rescan after the import too
+        auto track = playlist.tracks()[1];
+        touch(folder / "track1.txt", 5);
+        diff = playlist.rescanFolder(options);
+        CHECK(diff.updated.empty());
+        CHECK(playlist.tracks()[1] == track);
+
+        // Changed: replaced in place
+        writeTrack(folder / "track1.txt", "Changed", "content");
+        touch(folder / "track1.txt", 10);
+        diff = playlist.rescanFolder(options);
+        CHECK(diff.updated.size() == 1);
+        CHECK(playlist.size() == 3);
+        CHECK(playlist.tracks()[1]->title() == "Changed");
+        CHECK((playlist.search("changed") == std::vector<int>{1}));
+
+        // Touched again, the hash is known now
+        touch(folder / "track1.txt", 15);
+        diff = playlist.rescanFolder(options);
+        CHECK(diff.updated.empty());
+
+        writeTrack(folder / "track3.txt", "Added", "content");
+        fs::remove(folder / "track0.txt");
+        diff = playlist.rescanFolder(options);
+        CHECK(diff.added.size() == 1 && diff.removed.size() == 1 && diff.updated.empty());
+        CHECK(playlist.size() == 3);
+        CHECK((playlist.search("added") == std::vector<int>{2}));
+        CHECK(playlist.search("title0").empty());
+
+        // Back to the initial folder for the next mode
+        writeTrack(folder / "track0.txt", "Title0", "content");
+        writeTrack(folder / "track1.txt", "Title1", "content");
+        fs::remove(folder / "track3.txt");
+    }
+    fs::remove_all(folder);
+}
+
+// Titles in the order the playlist plays them, from its first track
+std::vector<std::string> playedTitles(Playlist& playlist)
+{
+    std::vector<std::string> titles;
+    for (auto track = playlist.resetToFirstTrack(); track; track = playlist.nextTrack(true))
+    {
+        titles.push_back(std::string(track->title()));
+    }
+    return titles;
+}
+
+void testRescanArena()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 3; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i), "content");
+    }
+    std::ofstream(folder / "invalid.txt") << "not a track\n";
+
+    Playlist playlist;
+    CHECK(playlist.importFromFolder(folder, ImportOptions{}) == 3);
+    auto arena = playlist.arena();
+    // The failed load took no slot
+    CHECK(arena->trackCount() == 3);
+
+    // Every rescan replacing a track frees the one it replaced last time, the arena does not grow
+    std::weak_ptr<const Track> replaced;
+    for (int i = 0; i < 3; ++i)
+    {
+        writeTrack(folder / "track1.txt", "Changed" + std::to_string(i), "content");
+        touch(folder / "track1.txt", 10 * (i + 1));
+        CHECK(playlist.rescanFolder(ImportOptions{}).updated.size() == 1);
+        CHECK(replaced.expired());
+        replaced = playlist.tracks()[1];
+    }
+    CHECK(arena->trackCount() == 3);
+    fs::remove_all(folder);
+}
+
+void testSeededPlaylist()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 30; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i), "content");
+    }
+
+    // Seeded after the import, as the player and the benchmarks do
+    auto shuffledWith = [&folder](unsigned seed)
+    {
+        Playlist playlist;
+        playlist.importFromFolder(folder, ImportOptions{});
+        playlist.seed(seed);
+        playlist.shuffle();
+        return playedTitles(playlist);
+    };
+    auto first = shuffledWith(42);
+    CHECK(first.size() == 30);
+    CHECK(shuffledWith(42) == first);
+    CHECK(shuffledWith(43) != first);
+
+    // Seeded once shuffled: the order is drawn again, from the current track
+    Playlist playlist;
+    playlist.importFromFolder(folder, ImportOptions{});
+    playlist.shuffle();
+    playlist.seed(42);
+    auto reseeded = playedTitles(playlist);
+    CHECK(reseeded.front() == "Title0");
+    playlist.seek(0);
+    playlist.seed(42);
+    CHECK(playedTitles(playlist) == reseeded);
+    fs::remove_all(folder);
+}
+
+void testContentSearch()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    writeTrack(folder / "track0.txt", "First", "alpha beta");
+    writeTrack(folder / "track1.txt", "Second", "beta gamma");
+
+    for (bool indexContent : {false, true})
+    {
+        ImportOptions options;
+        options.loadMode = TrackLoadMode::Lazy;
+        options.indexContent = indexContent;
+        Playlist playlist;
+        CHECK(playlist.importFromFolder(folder, options) == 2);
+        CHECK((playlist.search("second") == std::vector<int>{1}));
+        if (indexContent)
+        {
+            CHECK((playlist.search("beta") == std::vector<int>{0, 1}));
+            CHECK((playlist.search("gam*") == std::vector<int>{1}));
+            // Read for the index, evicted again
+            CHECK(!playlist.tracks()[0]->isContentLoaded());
+        }
+        else
+        {
+            CHECK(playlist.search("beta").empty());
+        }
+
+        writeTrack(folder / "added.txt", "Added", "delta");
+        CHECK(playlist.addTrackFromFile(folder / "added.txt", options));
+        CHECK(playlist.search("delta").size() == (indexContent ? 1u : 0u));
+        fs::remove(folder / "added.txt");
+    }
+    fs::remove_all(folder);
+}
+
+void testRenderCompileEviction()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 3; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i),
+                   "content" + std::to_string(i));
+    }
+    ImportOptions options;
+    options.loadMode = TrackLoadMode::Lazy;
+    Playlist playlist;
+    CHECK(playlist.importFromFolder(folder, options) == 3);
+    playlist.tracks()[1]->content(); // resident before, stays so
+
+    ContentWriter writer;
+    CHECK(writer.open(folder / "render.out"));
+    auto stats = render::renderPlaylist(playlist, writer);
+    CHECK(stats.ok && stats.tracks == 3);
+    std::ifstream rendered(folder / "render.out");
+    std::string text((std::istreambuf_iterator<char>(rendered)), std::istreambuf_iterator<char>());
+    CHECK(text == "content0\ncontent1\ncontent2\n");
+    CHECK(!playlist.tracks()[0]->isContentLoaded());
+    CHECK(playlist.tracks()[1]->isContentLoaded());
+    CHECK(!playlist.tracks()[2]->isContentLoaded());
+
+    auto libraryPath = folder / ("tracks" + std::string(library::FileExtension));
+    CHECK(library::compile(playlist, libraryPath));
+    CHECK(!playlist.tracks()[0]->isContentLoaded());
+    CHECK(playlist.tracks()[1]->isContentLoaded());
+    auto loaded = library::load(libraryPath);
+    CHECK(loaded && loaded->tracks()[2]->content() == "content2");
+
+    // A file truncated since the import cannot be compiled
+    std::ofstream(folder / "track2.txt") << "title Title2\n";
+    CHECK(!library::compile(playlist, libraryPath));
+    CHECK(!fs::exists(libraryPath.string() + ".tmp"));
+    fs::remove_all(folder);
+}
+
+void testTrackCacheCharge()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    writeTrack(folder / "track.txt", "Title", std::string(1000, 'x'));
+
+    auto& cache = TrackCache::instance();
+    cache.clear();
+    auto lazy = cache.load(folder / "track.txt", TrackLoadMode::Lazy);
+    CHECK(lazy && !lazy->isContentLoaded());
+    // Charged the content it may load, not only the track
+    CHECK(cache.bytesUsed() == sizeof(Track) + 1000);
+    CHECK(cache.load(folder / "track.txt", TrackLoadMode::Lazy) == lazy);
+    CHECK(cache.hits() >= 1 && cache.size() == 1);
+
+    // Over the budget, the least recently used entry goes
+    writeTrack(folder / "other.txt", "Other", std::string(1000, 'y'));
+    auto budget = cache.budget();
+    cache.setBudget(sizeof(Track) + 1500);
+    cache.load(folder / "other.txt", TrackLoadMode::Lazy);
+    CHECK(cache.size() == 1 && cache.bytesUsed() == sizeof(Track) + 1000);
+    CHECK(cache.load(folder / "track.txt", TrackLoadMode::Lazy) != lazy);
+
+    cache.setBudget(budget);
+    cache.clear();
+    fs::remove_all(folder);
+}
+
+void testOutputPolicy()
+{
+    auto& sink = OutputSink::instance();
+    if (!std::getenv("IMPLAYER_OUTPUT_POLICY"))
+    {
+        // A slow terminal must not stall the streaming thread
+        CHECK(sink.policy() == BackpressurePolicy::Drop);
+    }
+    auto policy = sink.policy();
+    sink.setPolicy(BackpressurePolicy::Overwrite);
+    CHECK(sink.policy() == BackpressurePolicy::Overwrite);
+    CHECK(sink.writeContent(""));
+    sink.flush();
+    sink.setPolicy(policy);
+}
+
+void testReplay()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    writeTrack(folder / "track0.txt", "Title0", "content");
+    writeTrack(folder / "track1.txt", "Title1", "content");
+    std::ofstream(folder / "playlist.txt") << "Playlist\nDescription\n"
+                                           << (folder / "track0.txt").string() << "\n"
+                                           << (folder / "track1.txt").string() << "\n";
+
+    // Import (answering its prompt), shuffle, skip an invalid line and a comment, then quit
+    std::istringstream trace("# test trace\n0 N\n>" + (folder / "playlist.txt").string()
+                             + "\n0 S\nnot a command\n0 S\n0 Q\n0 D\n");
+    LatencyStats latencies;
+    {
+        TextBasedPlayer player;
+        player.init();
+        latencies = player.replay(trace, false);
+    }
+    CHECK(latencies.summary("set-playlist").count == 1);
+    CHECK(latencies.summary("shuffle").count == 2);
+    // Nothing after the quit
+    CHECK(latencies.summary("next").count == 0);
+    fs::remove_all(folder);
+}
+
+void testMetrics()
+{
+    Histogram histogram;
+    CHECK(histogram.count() == 0 && histogram.percentile(50) == 0 && histogram.mean() == 0.0);
+    // Below SubBucketCount every value has its own bucket
+    for (std::uint64_t value = 1; value <= 10; ++value)
+    {
+        histogram.record(value);
+    }
+    CHECK(histogram.count() == 10 && histogram.max() == 10 && histogram.mean() == 5.5);
+    CHECK(histogram.percentile(50) == 5 && histogram.percentile(90) == 9 && histogram.percentile(100) == 10);
+
+    // Larger values land within 1/SubBucketCount of their bucket's highest value, capped by the max
+    histogram.reset();
+    CHECK(histogram.count() == 0 && histogram.max() == 0);
+    for (std::uint64_t value = 1000; value <= 100000; value += 1000)
+    {
+        histogram.record(value);
+    }
+    for (double p : {10.0, 50.0, 90.0, 99.0})
+    {
+        auto exact = static_cast<std::uint64_t>(p * 1000);
+        auto reported = histogram.percentile(p);
+        CHECK(reported >= exact && reported - exact <= exact / Histogram::SubBucketCount);
+    }
+    CHECK(histogram.percentile(100) == 100000);
+
+    // Wait-free recording from several threads loses nothing
+    Histogram shared;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&shared, t]
+        {
+            for (int i = 0; i < 10000; ++i)
+            {
+                shared.record(static_cast<std::uint64_t>(t * 10000 + i));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(shared.count() == 40000 && shared.max() == 39999);
+
+    // Nearest rank over the samples of a name, or of all of them
+    LatencyStats latencies;
+    for (int us = 1; us <= 100; ++us)
+    {
+        latencies.record("next", std::chrono::microseconds(us));
+    }
+    latencies.record("quit", std::chrono::microseconds(1000));
+    auto next = latencies.summary("next");
+    CHECK(next.count == 100 && next.p50 == std::chrono::microseconds(50) && next.p90 == std::chrono::microseconds(90)
+          && next.p99 == std::chrono::microseconds(99) && next.max == std::chrono::microseconds(100));
+    auto all = latencies.summary();
+    CHECK(latencies.count() == 101 && all.count == 101 && all.max == std::chrono::microseconds(1000));
+    CHECK(latencies.summary("missing").count == 0);
+    std::ostringstream report;
+    latencies.report(report);
+    CHECK(report.str().find("next") != std::string::npos && report.str().find("all") != std::string::npos);
+
+#ifndef _WIN32
+    // The player writes its histograms to $IMPLAYER_METRICS_FILE on exit
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    auto metricsFile = folder / "metrics.txt";
+    setenv("IMPLAYER_METRICS_FILE", metricsFile.c_str(), 1);
+    {
+        std::istringstream trace("0 S\n0 S\n0 Q\n");
+        TextBasedPlayer player;
+        player.init();
+        player.replay(trace, false);
+    }
+    unsetenv("IMPLAYER_METRICS_FILE");
+    std::ifstream in(metricsFile);
+    std::map<std::string, std::uint64_t> counts;
+    std::string line;
+    std::getline(in, line); // header
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        std::uint64_t count = 0;
+        fields >> name >> count;
+        counts[name] = count;
+    }
+    CHECK(counts.count("command_latency_us") && counts["command_latency_us"] >= 3);
+    CHECK(counts.count("queue_depth") && counts["queue_depth"] > 0 && counts.count("tick_lateness_us"));
+    CHECK(counts.count("transition_us") && counts.count("output_dropped"));
+    fs::remove_all(folder);
+#endif
+}
+
+#ifndef _WIN32
+// What the logger writes to stderr while log runs
+template <typename Log>
+std::string captureStderr(const fs::path& path, Log&& log)
+{
+    OutputSink::instance().flush();
+    int saved = dup(2);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    dup2(fd, 2);
+    close(fd);
+    log();
+    OutputSink::instance().flush();
+    dup2(saved, 2);
+    close(saved);
+    std::ifstream in(path);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void testLogger()
+{
+    auto& logger = Logger::instance();
+    auto level = logger.level();
+    auto format = logger.format();
+    auto path = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+
+    logger.setLevel(LogLevel::Warn);
+    logger.setFormat(LogFormat::JsonLines);
+    CHECK(!logger.enabled(LogLevel::Info) && logger.enabled(LogLevel::Error));
+    int formatted = 0;
+    auto count = [&formatted] { return ++formatted; };
+    auto records = captureStderr(path, [&count]
+    {
+        DEBUG_LOG("hidden " << count());
+        WARN_MSG("a \"quoted\" warning\nover two lines");
+        ERROR_LOG("an error " << count());
+    });
+    // One escaped JSON record per enabled message, the disabled one not even formatted
+    CHECK(formatted == 1);
+    CHECK(std::count(records.begin(), records.end(), '\n') == 2);
+    CHECK(records.find("\"level\":\"warn\"") != std::string::npos);
+    CHECK(records.find("a \\\"quoted\\\" warning\\nover two lines") != std::string::npos);
+    CHECK(records.find("\"level\":\"error\"") != std::string::npos);
+    CHECK(records.find("hidden") == std::string::npos);
+
+    logger.setLevel(LogLevel::Off);
+    CHECK(captureStderr(path, [] { ERROR_LOG("off"); }).empty());
+
+    logger.setLevel(level);
+    logger.setFormat(format);
+    fs::remove(path);
+}
+#endif
+
+#ifndef _WIN32
+void testEventLoop()
+{
+    EventLoop loop;
+    std::vector<std::string> events;
+    auto start = EventLoop::Clock::now();
+    // Timers in deadline order, FIFO among equal deadlines
+    loop.runAt(start + std::chrono::milliseconds(20), [&events] { events.push_back("timer2"); });
+    loop.runAt(start + std::chrono::milliseconds(10), [&events] { events.push_back("timer1"); });
+    loop.runAt(start + std::chrono::milliseconds(20), [&events] { events.push_back("timer3"); });
+
+    int data[2];
+    CHECK(pipe(data) == 0);
+    std::string received;
+    loop.watch(data[0], [&]
+    {
+        char buffer[64];
+        auto count = read(data[0], buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            received.append(buffer, count);
+            return;
+        }
+        // End of the input
+        events.push_back("eof");
+        loop.unwatch(data[0]);
+        close(data[0]);
+    });
+
+    // Closed while watched: dispatched (POLLNVAL) rather than spinning or ignored
+    int closed[2];
+    CHECK(pipe(closed) == 0);
+    int closedCalls = 0;
+    loop.watch(closed[0], [&] { closedCalls++; loop.unwatch(closed[0]); });
+    loop.runAt(start + std::chrono::milliseconds(5), [&closed] { close(closed[0]); });
+
+    std::thread other([&]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        loop.post([&events] { events.push_back("posted"); });
+        CHECK(write(data[1], "hello", 5) == 5);
+        close(data[1]);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        loop.stop();
+    });
+    loop.run();
+    other.join();
+    close(closed[1]);
+
+    CHECK(received == "hello");
+    CHECK(closedCalls == 1);
+    CHECK(events.size() == 5);
+    CHECK((std::vector<std::string>(events.begin(), events.begin() + 3)
+           == std::vector<std::string>{"timer1", "timer2", "timer3"}));
+    CHECK(std::count(events.begin(), events.end(), "posted") == 1 && events.back() == "eof");
+}
+#endif
+
+void testLibraryRecompile()
+{
+    auto folder = fs::temp_directory_path() / ("implayer_test_" + std::to_string(std::random_device{}()));
+    fs::create_directories(folder);
+    for (int i = 0; i < 3; ++i)
+    {
+        writeTrack(folder / ("track" + std::to_string(i) + ".txt"), "Title" + std::to_string(i),
+                   std::string(5000, static_cast<char>('a' + i)));
+    }
+    Playlist imported;
+    CHECK(imported.importFromFolder(folder, ImportOptions{}) == 3);
+    auto libraryPath = folder / ("tracks" + std::string(library::FileExtension));
+    CHECK(library::compile(imported, libraryPath));
+
+    // Compiled over the file its tracks are mapped from, they stay readable
+    auto loaded = library::load(libraryPath);
+    CHECK(loaded && loaded->size() == 3);
+    loaded->setName("Recompiled");
+    CHECK(library::compile(*loaded, libraryPath));
+    CHECK(!fs::exists(libraryPath.string() + ".tmp"));
+    CHECK(loaded->tracks()[2]->content() == std::string(5000, 'c'));
+
+    auto reloaded = library::load(libraryPath);
+    CHECK(reloaded && reloaded->name() == "Recompiled" && reloaded->size() == 3);
+    CHECK(reloaded->tracks()[1]->title() == "Title1");
+    CHECK(reloaded->tracks()[1]->content() == std::string(5000, 'b'));
+    CHECK(reloaded->search("bbbbb").empty());
+    auto indexed = library::load(libraryPath, true);
+    CHECK(indexed && (indexed->search(std::string(5000, 'b')) == std::vector<int>{1}));
+    fs::remove_all(folder);
+}
+}
+
+int main()
+{
+    testSeededShuffle();
+    testReshuffle();
+    testEraseAppend();
+    testPeekNext();
+    testStringPool();
+    testRemoveDuplicate();
+    testPlaybackEngine();
+    testTrackCursor();
+    testTrackIndex();
+    testPrefixMerge();
+    testChunkedStreaming();
+    testParallelImport();
+    testTrackParser();
+    testLazyLoading();
+    testRescanJournal();
+    testRescanArena();
+    testSeededPlaylist();
+    testContentSearch();
+    testRenderCompileEviction();
+    testTrackCacheCharge();
+    testOutputPolicy();
+    testReplay();
+    testMetrics();
+#ifndef _WIN32
+    testLogger();
+    testEventLoop();
+#endif
+    testLibraryRecompile();
+
+    OutputSink::instance().flush();
+    if (failures > 0)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}